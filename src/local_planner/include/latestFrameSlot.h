@@ -0,0 +1,64 @@
+#ifndef LOCAL_PLANNER_LATEST_FRAME_SLOT_H
+#define LOCAL_PLANNER_LATEST_FRAME_SLOT_H
+
+#include <stdint.h>
+#include <atomic>
+
+// Lock-free single-producer/single-consumer handoff of the latest frame (triple buffer).
+// The producer fills writeBuffer() and calls publish(), the consumer calls update() and reads
+// readBuffer(). Neither side blocks, and a frame not picked up before the next publish() is
+// dropped. Each side owns its buffer exclusively until its next publish()/update().
+template <typename T>
+class LatestFrameSlot
+{
+public:
+  LatestFrameSlot() : writeIndex_(0), readIndex_(2), middle_(1) {}
+
+  T& writeBuffer()
+  {
+    return buffers_[writeIndex_];
+  }
+
+  void publish()
+  {
+    uint8_t middle = middle_.exchange(writeIndex_ | newFrameBit, std::memory_order_acq_rel);
+    writeIndex_ = middle & indexMask;
+  }
+
+  // returns true if a new frame was taken, readBuffer() then holds it
+  bool update()
+  {
+    if ((middle_.load(std::memory_order_relaxed) & newFrameBit) == 0) return false;
+
+    uint8_t middle = middle_.exchange(readIndex_, std::memory_order_acq_rel);
+    readIndex_ = middle & indexMask;
+    return true;
+  }
+
+  bool hasNewFrame() const
+  {
+    return (middle_.load(std::memory_order_acquire) & newFrameBit) != 0;
+  }
+
+  T& readBuffer()
+  {
+    return buffers_[readIndex_];
+  }
+
+  // buffer access for setup before the producer and consumer start
+  T& buffer(int ind)
+  {
+    return buffers_[ind];
+  }
+
+private:
+  static const uint8_t indexMask = 0x3;
+  static const uint8_t newFrameBit = 0x4;
+
+  T buffers_[3];
+  uint8_t writeIndex_;
+  uint8_t readIndex_;
+  std::atomic<uint8_t> middle_;
+};
+
+#endif
@@ -0,0 +1,229 @@
+#ifndef LOCAL_PLANNER_PATH_LIBRARY_H
+#define LOCAL_PLANNER_PATH_LIBRARY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+// Packed binary path library, mapped by localPlanner and used in place. All tables are
+// stored as SoA arrays, startPaths/paths/correspondences as CSR (start offsets + entries).
+// Each section starts on a 64-byte boundary, offsets are in bytes from the file start.
+
+const uint32_t pathLibraryMagic = 0x42494c50; // "PLIB"
+const uint32_t pathLibraryVersion = 1;
+const uint64_t pathLibraryAlignment = 64;
+
+struct PathLibraryHeader
+{
+  uint32_t magic;
+  uint32_t version;
+
+  int32_t pathNum;
+  int32_t groupNum;
+  int32_t gridVoxelNumX;
+  int32_t gridVoxelNumY;
+  int32_t gridVoxelNumZ;
+  float gridVoxelSize;
+  float searchRadiusHori;
+  float searchRadiusVert;
+  float gridVoxelOffsetX;
+  float gridVoxelOffsetY;
+  float gridVoxelOffsetZ;
+
+  int32_t startPathPointNum;
+  int32_t pathPointNum;
+  int32_t correspondenceNum;
+
+  uint64_t pathGroupOffset;           // int32[pathNum]
+  uint64_t endPitchOffset;            // float[pathNum], deg
+  uint64_t endYawOffset;              // float[pathNum], deg
+  uint64_t endZOffset;                // float[pathNum]
+  uint64_t startPathStartOffset;      // int32[groupNum + 1]
+  uint64_t startPathXOffset;          // float[startPathPointNum]
+  uint64_t startPathYOffset;
+  uint64_t startPathZOffset;
+  uint64_t pathPointStartOffset;      // int32[pathNum + 1]
+  uint64_t pathPointXOffset;          // float[pathPointNum]
+  uint64_t pathPointYOffset;
+  uint64_t pathPointZOffset;
+  uint64_t pathPointIntensityOffset;
+  uint64_t correspondenceStartOffset; // int32[gridVoxelNum + 1]
+  uint64_t correspondenceOffset;      // uint16[correspondenceNum]
+  uint64_t fileSize;
+};
+
+struct PathLibraryData
+{
+  int pathNum;
+  int groupNum;
+  int gridVoxelNumX;
+  int gridVoxelNumY;
+  int gridVoxelNumZ;
+  float gridVoxelSize;
+  float searchRadiusHori;
+  float searchRadiusVert;
+  float gridVoxelOffsetX;
+  float gridVoxelOffsetY;
+  float gridVoxelOffsetZ;
+
+  std::vector<int32_t> pathGroup;
+  std::vector<float> endPitch;
+  std::vector<float> endYaw;
+  std::vector<float> endZ;
+  std::vector<int32_t> startPathStart;
+  std::vector<float> startPathX;
+  std::vector<float> startPathY;
+  std::vector<float> startPathZ;
+  std::vector<int32_t> pathPointStart;
+  std::vector<float> pathPointX;
+  std::vector<float> pathPointY;
+  std::vector<float> pathPointZ;
+  std::vector<float> pathPointIntensity;
+  std::vector<int32_t> correspondenceStart;
+  std::vector<uint16_t> correspondence;
+};
+
+inline uint64_t alignPathLibraryOffset(uint64_t offset)
+{
+  return (offset + pathLibraryAlignment - 1) / pathLibraryAlignment * pathLibraryAlignment;
+}
+
+inline uint64_t reservePathLibrarySection(uint64_t& fileSize, uint64_t sectionSize)
+{
+  uint64_t offset = alignPathLibraryOffset(fileSize);
+  fileSize = offset + sectionSize;
+  return offset;
+}
+
+template <typename T>
+inline bool writePathLibrarySection(FILE *filePtr, uint64_t offset, const std::vector<T>& data)
+{
+  if (data.empty()) return true;
+  if (fseek(filePtr, offset, SEEK_SET) != 0) return false;
+  return fwrite(data.data(), sizeof(T), data.size(), filePtr) == data.size();
+}
+
+inline bool writePathLibrary(const char *fileName, const PathLibraryData& lib)
+{
+  uint64_t gridVoxelNum = uint64_t(lib.gridVoxelNumX) * lib.gridVoxelNumY * lib.gridVoxelNumZ;
+  if (int(lib.pathGroup.size()) != lib.pathNum || int(lib.endPitch.size()) != lib.pathNum ||
+      int(lib.endYaw.size()) != lib.pathNum || int(lib.endZ.size()) != lib.pathNum ||
+      int(lib.startPathStart.size()) != lib.groupNum + 1 || int(lib.pathPointStart.size()) != lib.pathNum + 1 ||
+      lib.correspondenceStart.size() != gridVoxelNum + 1 || lib.pathNum > 65535) {
+    return false;
+  }
+
+  PathLibraryHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = pathLibraryMagic;
+  header.version = pathLibraryVersion;
+  header.pathNum = lib.pathNum;
+  header.groupNum = lib.groupNum;
+  header.gridVoxelNumX = lib.gridVoxelNumX;
+  header.gridVoxelNumY = lib.gridVoxelNumY;
+  header.gridVoxelNumZ = lib.gridVoxelNumZ;
+  header.gridVoxelSize = lib.gridVoxelSize;
+  header.searchRadiusHori = lib.searchRadiusHori;
+  header.searchRadiusVert = lib.searchRadiusVert;
+  header.gridVoxelOffsetX = lib.gridVoxelOffsetX;
+  header.gridVoxelOffsetY = lib.gridVoxelOffsetY;
+  header.gridVoxelOffsetZ = lib.gridVoxelOffsetZ;
+  header.startPathPointNum = lib.startPathX.size();
+  header.pathPointNum = lib.pathPointX.size();
+  header.correspondenceNum = lib.correspondence.size();
+
+  uint64_t fileSize = sizeof(PathLibraryHeader);
+  header.pathGroupOffset = reservePathLibrarySection(fileSize, 4 * lib.pathGroup.size());
+  header.endPitchOffset = reservePathLibrarySection(fileSize, 4 * lib.endPitch.size());
+  header.endYawOffset = reservePathLibrarySection(fileSize, 4 * lib.endYaw.size());
+  header.endZOffset = reservePathLibrarySection(fileSize, 4 * lib.endZ.size());
+  header.startPathStartOffset = reservePathLibrarySection(fileSize, 4 * lib.startPathStart.size());
+  header.startPathXOffset = reservePathLibrarySection(fileSize, 4 * lib.startPathX.size());
+  header.startPathYOffset = reservePathLibrarySection(fileSize, 4 * lib.startPathY.size());
+  header.startPathZOffset = reservePathLibrarySection(fileSize, 4 * lib.startPathZ.size());
+  header.pathPointStartOffset = reservePathLibrarySection(fileSize, 4 * lib.pathPointStart.size());
+  header.pathPointXOffset = reservePathLibrarySection(fileSize, 4 * lib.pathPointX.size());
+  header.pathPointYOffset = reservePathLibrarySection(fileSize, 4 * lib.pathPointY.size());
+  header.pathPointZOffset = reservePathLibrarySection(fileSize, 4 * lib.pathPointZ.size());
+  header.pathPointIntensityOffset = reservePathLibrarySection(fileSize, 4 * lib.pathPointIntensity.size());
+  header.correspondenceStartOffset = reservePathLibrarySection(fileSize, 4 * lib.correspondenceStart.size());
+  header.correspondenceOffset = reservePathLibrarySection(fileSize, 2 * lib.correspondence.size());
+  header.fileSize = alignPathLibraryOffset(fileSize);
+
+  FILE *filePtr = fopen(fileName, "wb");
+  if (filePtr == NULL) {
+    return false;
+  }
+
+  bool status = fwrite(&header, sizeof(header), 1, filePtr) == 1 &&
+                writePathLibrarySection(filePtr, header.pathGroupOffset, lib.pathGroup) &&
+                writePathLibrarySection(filePtr, header.endPitchOffset, lib.endPitch) &&
+                writePathLibrarySection(filePtr, header.endYawOffset, lib.endYaw) &&
+                writePathLibrarySection(filePtr, header.endZOffset, lib.endZ) &&
+                writePathLibrarySection(filePtr, header.startPathStartOffset, lib.startPathStart) &&
+                writePathLibrarySection(filePtr, header.startPathXOffset, lib.startPathX) &&
+                writePathLibrarySection(filePtr, header.startPathYOffset, lib.startPathY) &&
+                writePathLibrarySection(filePtr, header.startPathZOffset, lib.startPathZ) &&
+                writePathLibrarySection(filePtr, header.pathPointStartOffset, lib.pathPointStart) &&
+                writePathLibrarySection(filePtr, header.pathPointXOffset, lib.pathPointX) &&
+                writePathLibrarySection(filePtr, header.pathPointYOffset, lib.pathPointY) &&
+                writePathLibrarySection(filePtr, header.pathPointZOffset, lib.pathPointZ) &&
+                writePathLibrarySection(filePtr, header.pathPointIntensityOffset, lib.pathPointIntensity) &&
+                writePathLibrarySection(filePtr, header.correspondenceStartOffset, lib.correspondenceStart) &&
+                writePathLibrarySection(filePtr, header.correspondenceOffset, lib.correspondence);
+
+  if (status && header.fileSize > fileSize) {
+    status = fseek(filePtr, header.fileSize - 1, SEEK_SET) == 0 && fputc(0, filePtr) != EOF;
+  }
+
+  if (fclose(filePtr) != 0) {
+    status = false;
+  }
+
+  return status;
+}
+
+inline bool checkPathLibrarySection(const PathLibraryHeader& header, uint64_t offset, uint64_t sectionSize)
+{
+  return offset % 4 == 0 && offset >= sizeof(PathLibraryHeader) && offset + sectionSize <= header.fileSize;
+}
+
+inline bool checkPathLibraryHeader(const PathLibraryHeader& header, uint64_t fileSize)
+{
+  if (fileSize < sizeof(PathLibraryHeader) || header.magic != pathLibraryMagic ||
+      header.version != pathLibraryVersion || header.fileSize != fileSize) {
+    return false;
+  }
+
+  if (header.pathNum <= 0 || header.pathNum > 65535 || header.groupNum <= 0 || header.gridVoxelNumX <= 0 ||
+      header.gridVoxelNumY <= 0 || header.gridVoxelNumZ <= 0 || header.startPathPointNum < 0 ||
+      header.pathPointNum < 0 || header.correspondenceNum < 0) {
+    return false;
+  }
+
+  uint64_t pathNum = header.pathNum;
+  uint64_t groupNum = header.groupNum;
+  uint64_t gridVoxelNum = uint64_t(header.gridVoxelNumX) * header.gridVoxelNumY * header.gridVoxelNumZ;
+  uint64_t startPathPointNum = header.startPathPointNum;
+  uint64_t pathPointNum = header.pathPointNum;
+  uint64_t correspondenceNum = header.correspondenceNum;
+
+  return checkPathLibrarySection(header, header.pathGroupOffset, 4 * pathNum) &&
+         checkPathLibrarySection(header, header.endPitchOffset, 4 * pathNum) &&
+         checkPathLibrarySection(header, header.endYawOffset, 4 * pathNum) &&
+         checkPathLibrarySection(header, header.endZOffset, 4 * pathNum) &&
+         checkPathLibrarySection(header, header.startPathStartOffset, 4 * (groupNum + 1)) &&
+         checkPathLibrarySection(header, header.startPathXOffset, 4 * startPathPointNum) &&
+         checkPathLibrarySection(header, header.startPathYOffset, 4 * startPathPointNum) &&
+         checkPathLibrarySection(header, header.startPathZOffset, 4 * startPathPointNum) &&
+         checkPathLibrarySection(header, header.pathPointStartOffset, 4 * (pathNum + 1)) &&
+         checkPathLibrarySection(header, header.pathPointXOffset, 4 * pathPointNum) &&
+         checkPathLibrarySection(header, header.pathPointYOffset, 4 * pathPointNum) &&
+         checkPathLibrarySection(header, header.pathPointZOffset, 4 * pathPointNum) &&
+         checkPathLibrarySection(header, header.pathPointIntensityOffset, 4 * pathPointNum) &&
+         checkPathLibrarySection(header, header.correspondenceStartOffset, 4 * (gridVoxelNum + 1)) &&
+         checkPathLibrarySection(header, header.correspondenceOffset, 2 * correspondenceNum);
+}
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef LOCAL_PLANNER_PATH_SCORING_H
+#define LOCAL_PLANNER_PATH_SCORING_H
+
+#include <math.h>
+#include <stdint.h>
+
+// Path scoring split into a per-frame pass and a per-scale pass. The sensor FOV check and the
+// goal direction score depend only on the frame, so they are computed once for all scales in
+// loops over the SoA path tables, which vectorize when the including file is compiled with
+// -fno-trapping-math (set in CMakeLists.txt). The per-scale pass then only adds the FOV
+// penalty to the collision counts and accumulates the scores of the free paths over the
+// contiguous path range of each group. The expressions, their float/double mix and the order
+// of the additions within a group are those of the original single loop, so the group scores
+// are bit-identical. For that the per-group sums stay scalar on purpose, a vectorized
+// reduction would reorder the additions.
+
+const double pathScoringPI = 3.1415926;
+
+struct PathScoringFrame
+{
+  float trackPitch;
+  float trackYaw;
+  float trackZ;
+  float vehiclePitch;
+  float vehicleYaw;
+  double depthCamPitchOffset;
+  double sensorMaxPitch;
+  double sensorMaxYaw;
+  double maxElev;
+  float relativeGoalPitch;
+  float relativeGoalYaw;
+  double pitchDiffLimit;
+  double pitchWeight;
+  double yawWeight;
+  int pointPerPathThre;
+};
+
+// fovPenalty[i] is pointPerPathThre for paths outside the sensor FOV or above maxElev, else 0,
+// pathScore[i] is the goal direction score including the tie-break offset
+inline void scorePathsForFrame(const PathScoringFrame& frame, int pathNum, const float *endPitch,
+                               const float *endYaw, const float *endZ, int *fovPenalty, double *pathScore)
+{
+  const double trackPitchDeg = frame.trackPitch * 180.0 / pathScoringPI;
+  const double trackYawDeg = frame.trackYaw * 180.0 / pathScoringPI;
+  const double vehiclePitchDeg = frame.vehiclePitch * 180.0 / pathScoringPI;
+  const double vehicleYawDeg = frame.vehicleYaw * 180.0 / pathScoringPI;
+  const double depthCamPitchDeg = frame.depthCamPitchOffset * 180.0 / pathScoringPI;
+
+  for (int i = 0; i < pathNum; i++) {
+    float pitchDiff = fabs(endPitch[i] + trackPitchDeg - vehiclePitchDeg - depthCamPitchDeg);
+    float yaw = trackYawDeg + endYaw[i];
+    float yawDiff = fabs(yaw - vehicleYawDeg);
+    yawDiff = yawDiff > 180.0 ? float(360.0 - yawDiff) : yawDiff;
+    float elev = frame.trackZ + endZ[i];
+    bool outside = (yawDiff > frame.sensorMaxYaw) | (pitchDiff > frame.sensorMaxPitch) | (elev > frame.maxElev);
+    fovPenalty[i] = outside ? frame.pointPerPathThre : 0;
+  }
+
+  for (int i = 0; i < pathNum; i++) {
+    float pitchDiff = fabs(frame.relativeGoalPitch - endPitch[i]);
+    pitchDiff = pitchDiff > frame.pitchDiffLimit ? float(frame.pitchDiffLimit) : pitchDiff;
+    float yawDiff = fabs(frame.relativeGoalYaw - endYaw[i]);
+    yawDiff = yawDiff > 180.0 ? float(360.0 - yawDiff) : yawDiff;
+
+    float score = (1 - frame.pitchWeight * pitchDiff) * (1 - frame.yawWeight * yawDiff);
+    score = score < 0 ? 0 : score;
+    pathScore[i] = score + 0.000001;
+  }
+}
+
+// adds the FOV penalty to the collision counts and sums the scores of the free paths per group,
+// the paths of group g are the contiguous ID range [groupPathStart[g], groupPathStart[g + 1])
+inline void accumulateGroupScores(int groupNum, const int *groupPathStart, int pointPerPathThre, const int *fovPenalty,
+                                  const double *pathScore, int *clearPathList, float *groupScore)
+{
+  for (int g = 0; g < groupNum; g++) {
+    float score = 0;
+    int pathEnd = groupPathStart[g + 1];
+    for (int i = groupPathStart[g]; i < pathEnd; i++) {
+      int clearCount = clearPathList[i] + fovPenalty[i];
+      clearPathList[i] = clearCount;
+      score += clearCount < pointPerPathThre ? pathScore[i] : 0.0;
+    }
+    groupScore[g] = score;
+  }
+}
+
+#endif
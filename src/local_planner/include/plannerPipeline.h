@@ -0,0 +1,279 @@
+#ifndef LOCAL_PLANNER_PLANNER_PIPELINE_H
+#define LOCAL_PLANNER_PLANNER_PIPELINE_H
+
+#include <math.h>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+#include <vector>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+#include "voxelHashFilter.h"
+#include "latestFrameSlot.h"
+#include "stageProfiler.h"
+#include "plannerRecording.h"
+
+// Scan preprocessing and path search of localPlanner, free of ROS so that the same code runs
+// in the node and in plannerReplay. As in the node, the state is kept in globals. The caller
+// sets the parameters and calls initPlannerPipeline() once, feeds odometry with addOdometry()
+// and each scan as points passed to addCropPoint() between startLaserFrame() and
+// finishLaserFrame(), and plans with takePlannerFrame() and planPaths(). plannerReplay starts
+// the scans with startRecordedLaserFrame() instead and feeds no odometry.
+
+// pipeline parameters
+extern std::string pathFolder;
+extern bool usePathLibrary;
+extern double depthCloudDelay;
+extern bool useCloudStamp;
+extern double depthCamPitchOffset;
+extern double depthCamXOffset;
+extern double depthCamYOffset;
+extern double depthCamZOffset;
+extern double scanVoxelSize;
+extern bool useVoxelHashFilter;
+extern bool temporalFilter;
+extern int temporalFilterFrames;
+extern int temporalFilterMinHits;
+extern double temporalFilterPassDis;
+extern bool threadedIngest;
+extern bool eventDrivenPlanning;
+extern bool parallelScaleSearch;
+extern int laserCloudStackNum;
+extern int pointPerPathThre;
+extern bool bitsetVoting;
+extern double maxRange;
+extern double maxElev;
+extern bool keepSurrCloud;
+extern double keepHoriDis;
+extern double keepVertDis;
+extern int keepDecayFrames;
+extern int keepMinHits;
+extern double lowerBoundZ;
+extern double upperBoundZ;
+extern double pitchDiffLimit;
+extern double pitchWeight;
+extern double sensorMaxPitch;
+extern double sensorMaxYaw;
+extern double yawDiffLimit;
+extern double yawWeight;
+extern double pathScale;
+extern double minPathScale;
+extern double pathScaleStep;
+extern bool pathScaleBySpeed;
+extern double stopDis;
+extern double goalX;
+extern double goalY;
+extern double goalZ;
+
+// path parameters, set according to path files
+extern int pathNum;
+extern int groupNum;
+extern float gridVoxelSize;
+extern float searchRadiusHori;
+extern float searchRadiusVert;
+extern float gridVoxelOffsetX;
+extern float gridVoxelOffsetY;
+extern float gridVoxelOffsetZ;
+extern int gridVoxelNumX;
+extern int gridVoxelNumY;
+extern int gridVoxelNumZ;
+
+// operator input and the track point, read when planning
+extern float joyFwd;
+extern float joyLeft;
+extern float joyUp;
+extern bool manualMode;
+extern bool autonomyMode;
+extern bool autoAdjustMode;
+extern int systemInitDelay;
+
+extern float trackX;
+extern float trackY;
+extern float trackZ;
+extern float trackRoll;
+extern float trackPitch;
+extern float trackYaw;
+
+// path tables, startPaths, paths and correspondences are CSR arrays, paths are in group order
+// with group i holding the path IDs groupPathStart[i] to groupPathStart[i + 1] - 1
+extern const int *startPathStart;
+extern const float *startPathX;
+extern const float *startPathY;
+extern const float *startPathZ;
+extern const int *pathPointStart;
+extern const float *pathPointX;
+extern const float *pathPointY;
+extern const float *pathPointZ;
+extern const float *pathPointIntensity;
+extern std::vector<int> groupPathStart;
+
+// path points are only used for visualization, read by readPaths() on demand unless mapped
+// with the path library
+extern bool pathPointsLoaded;
+extern bool pathPointsFailed;
+
+// vote and score state of the path search at one scale, kept per candidate scale so that the
+// scales can be searched concurrently
+struct PathSearch
+{
+  double pathScale;
+  int selectedGroupID;
+  std::vector<int> clearPathList;
+  std::vector<float> clearPathPerGroupScore;
+  std::vector<uint64_t> pathCountPlanes;
+  std::vector<uint64_t> blockedPathWords;
+};
+
+extern std::vector<PathSearch> pathSearches;
+
+// goal in the track point frame, shared by all scales of a frame
+extern float relativeGoalX;
+extern float relativeGoalDis;
+extern float relativeGoalPitch;
+extern float relativeGoalYaw;
+
+// preprocessed scan with the vehicle attitude at scan time, in the world frame or, if nothing
+// needs the world frame, in the depth camera frame along with the camera to world transform
+struct PlannerFrame
+{
+  pcl::PointCloud<pcl::PointXYZ>::Ptr cloud;
+  bool cameraFrame;
+  float cameraToWorld[12];
+  double time;
+  double stamp;
+  float vehiclePitch;
+  float vehicleYaw;
+};
+
+extern LatestFrameSlot<PlannerFrame> plannerFrameSlot;
+extern std::mutex plannerFrameMutex;
+extern std::condition_variable plannerFrameCond;
+
+// frame taken by takePlannerFrame(), the cloud is moved to the track point frame by planPaths()
+extern pcl::PointCloud<pcl::PointXYZ>::Ptr plannerCloud;
+extern double plannerCloudTime;
+extern double plannerCloudStamp;
+extern float plannerVehiclePitch;
+extern float plannerVehicleYaw;
+extern bool plannerCloudCameraFrame;
+extern float plannerCameraToWorld[12];
+
+extern std::atomic<bool> clearSurrCloudRequest;
+
+// scan points passed to addCropPoint() are also kept in scanInputPoints (xyz interleaved)
+// while recordScanInput is set, and written to plannerRecorder as a scan record just before the
+// frame is handed to the planner. A planner taking frames while recording holds
+// plannerRecordMutex from takePlannerFrame() until its plan record is written, so the records
+// of a scan and of the plan on it are never separated by another scan.
+extern bool recordScanInput;
+extern std::vector<float> scanInputPoints;
+extern PlannerRecorder plannerRecorder;
+extern std::mutex plannerRecordMutex;
+
+extern pcl::PointCloud<pcl::PointXYZ>::Ptr laserCloudCrop;
+extern VoxelHashFilter scanHashFilter;
+
+// stage timings, filled by the pipeline and by the node
+enum PlannerStage
+{
+  stageScanInput,
+  stageScanDownsample,
+  stageScanTransform,
+  stageTemporalFilter,
+  stageKeepCloud,
+  stageCloudStack,
+  stageScanTotal,
+  stageCloudToTrack,
+  stageFrameScoring,
+  stagePathVoting,
+  stageGroupScoring,
+  stageScaleSearch,
+  stagePathExtraction,
+  stagePlanningTotal,
+  stageScanToPath,
+  stageVisualization,
+  plannerStageNum
+};
+
+extern const char *plannerStageNames[plannerStageNum];
+extern StageProfiler stageProfiler;
+
+// pipeline parameters by name, for recordings and replay
+struct PlannerParam
+{
+  const char *name;
+  char type;
+  void *value;
+};
+
+extern const PlannerParam plannerParams[];
+extern const int plannerParamNum;
+
+bool setPlannerParam(const std::string& name, const std::string& value);
+std::string getPlannerParam(const PlannerParam& param);
+
+// reads the path files and allocates the pipeline state, call once after setting parameters
+void initPlannerPipeline();
+
+void addOdometry(double time, float roll, float pitch, float yaw, float x, float y, float z);
+
+// takes the vehicle pose for the scan, interpolated at the scan stamp with useCloudStamp or
+// else at the newest odometry, both less depthCloudDelay, returns false while the system is
+// starting up
+bool startLaserFrame(double scanStamp);
+
+// starts a frame with the scan time and the vehicle pose taken from a scan record, in place of
+// startLaserFrame() when replaying
+void startRecordedLaserFrame(const ScanRecord& scan);
+
+// row-major 3x4 transform from the depth camera frame timeOffset after the scan time to the
+// depth camera frame at the scan time, for deskewing points captured over the scan, call after
+// startLaserFrame()
+bool getScanDeskewTransform(double timeOffset, float *transform);
+
+// point in the depth camera frame, cropped at maxRange and collected for downsampling
+inline void addCropPoint(float x, float y, float z)
+{
+  if (recordScanInput && isfinite(x) && isfinite(y) && isfinite(z)) {
+    scanInputPoints.push_back(x);
+    scanInputPoints.push_back(y);
+    scanInputPoints.push_back(z);
+  }
+
+  if (!(z < maxRange) || !isfinite(x) || !isfinite(y) || !isfinite(z)) {
+    return;
+  }
+
+  if (useVoxelHashFilter) {
+    scanHashFilter.addPoint(x, y, z);
+  } else {
+    pcl::PointXYZ point;
+    point.x = x;
+    point.y = y;
+    point.z = z;
+    laserCloudCrop->push_back(point);
+  }
+}
+
+// downsamples the cropped scan, transforms it to the world frame, updates the kept cloud and
+// hands the frame to the planner, scanStamp is the header stamp of the input message
+void finishLaserFrame(double scanStamp);
+
+// takes the latest preprocessed frame into plannerCloud, returns false if there is none
+bool takePlannerFrame();
+
+// plannerCloud in the world frame, call before planPaths()
+void getPlannerCloudWorld(pcl::PointCloud<pcl::PointXYZ>& cloud);
+
+// searches the candidate scales on plannerCloud, returns the index in pathSearches of the
+// largest scale with a free group or -1
+int planPaths();
+
+// returns false on a missing or malformed file, path points are then left empty
+bool readPaths();
+
+#endif
@@ -0,0 +1,166 @@
+#ifndef LOCAL_PLANNER_PLANNER_RECORDING_H
+#define LOCAL_PLANNER_PLANNER_RECORDING_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Binary recording of the localPlanner pipeline input for plannerReplay. The file starts with
+// the magic and version, followed by records of a type/size header and the payload. Records
+// are written in the order the node processed them: the pipeline parameters first, then scans
+// as the points passed to the crop step together with the scan time and the vehicle pose the
+// scan was transformed with, and one plan record with the operator input, the track point and
+// the stamp of the planned scan each time a frame is planned. A plan record always follows the
+// record of its scan, with no other scan in between. Odometry is not recorded, the pose is
+// taken from the scan record so that a replay does not depend on when odometry arrived.
+
+const uint32_t plannerRecordingMagic = 0x43524c50; // "PLRC"
+const uint32_t plannerRecordingVersion = 3;
+
+enum PlannerRecordType
+{
+  recordParams = 1,         // "name=value\n" lines
+  recordScan = 3,           // ScanRecord followed by pointNum x/y/z float triples
+  recordPlan = 4,           // PlanRecord
+  recordClearSurrCloud = 5  // no payload
+};
+
+struct PlannerRecordHeader
+{
+  uint32_t type;
+  uint32_t size;
+};
+
+// laserTime and the vehicle pose at it as taken by startLaserFrame()
+struct ScanRecord
+{
+  double stamp;
+  double laserTime;
+  float roll;
+  float pitch;
+  float yaw;
+  float x;
+  float y;
+  float z;
+  uint32_t pointNum;
+  uint32_t reserved;
+};
+
+struct PlanRecord
+{
+  double scanStamp;
+  double goalX;
+  double goalY;
+  double goalZ;
+  float trackX;
+  float trackY;
+  float trackZ;
+  float trackRoll;
+  float trackPitch;
+  float trackYaw;
+  float joyFwd;
+  float joyLeft;
+  float joyUp;
+  uint8_t manualMode;
+  uint8_t autonomyMode;
+  uint8_t autoAdjustMode;
+  uint8_t reserved;
+};
+
+// writes records from any thread, each record is written whole under the lock
+class PlannerRecorder
+{
+public:
+  PlannerRecorder() : filePtr_(NULL) {}
+
+  ~PlannerRecorder()
+  {
+    close();
+  }
+
+  bool open(const std::string& fileName)
+  {
+    filePtr_ = fopen(fileName.c_str(), "wb");
+    if (filePtr_ == NULL) {
+      return false;
+    }
+
+    uint32_t fileHeader[2] = {plannerRecordingMagic, plannerRecordingVersion};
+    fwrite(fileHeader, sizeof(fileHeader), 1, filePtr_);
+    return true;
+  }
+
+  bool isOpen() const
+  {
+    return filePtr_ != NULL;
+  }
+
+  void write(uint32_t type, const void *data, uint32_t size, const void *data2 = NULL, uint32_t size2 = 0)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (filePtr_ == NULL) {
+      return;
+    }
+
+    PlannerRecordHeader header = {type, size + size2};
+    fwrite(&header, sizeof(header), 1, filePtr_);
+    if (size > 0) fwrite(data, 1, size, filePtr_);
+    if (size2 > 0) fwrite(data2, 1, size2, filePtr_);
+  }
+
+  void close()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (filePtr_ != NULL) {
+      fclose(filePtr_);
+      filePtr_ = NULL;
+    }
+  }
+
+private:
+  FILE *filePtr_;
+  std::mutex mutex_;
+};
+
+class PlannerRecordReader
+{
+public:
+  PlannerRecordReader() : filePtr_(NULL) {}
+
+  ~PlannerRecordReader()
+  {
+    if (filePtr_ != NULL) fclose(filePtr_);
+  }
+
+  bool open(const std::string& fileName)
+  {
+    filePtr_ = fopen(fileName.c_str(), "rb");
+    if (filePtr_ == NULL) {
+      return false;
+    }
+
+    uint32_t fileHeader[2];
+    return fread(fileHeader, sizeof(fileHeader), 1, filePtr_) == 1 && fileHeader[0] == plannerRecordingMagic &&
+           fileHeader[1] == plannerRecordingVersion;
+  }
+
+  // returns false at the end of the file or on a truncated record
+  bool next(uint32_t& type, std::vector<char>& payload)
+  {
+    PlannerRecordHeader header;
+    if (fread(&header, sizeof(header), 1, filePtr_) != 1) {
+      return false;
+    }
+
+    type = header.type;
+    payload.resize(header.size);
+    return header.size == 0 || fread(&payload[0], 1, header.size, filePtr_) == header.size;
+  }
+
+private:
+  FILE *filePtr_;
+};
+
+#endif
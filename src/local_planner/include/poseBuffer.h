@@ -0,0 +1,310 @@
+#ifndef LOCAL_PLANNER_POSE_BUFFER_H
+#define LOCAL_PLANNER_POSE_BUFFER_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <type_traits>
+#include <vector>
+
+// Ring of time-stamped samples written by one thread and looked up by time from another,
+// samples are addressed by their sequence number, which keeps counting across wrap-arounds.
+// Lookups are binary searches over the samples still in the ring, so the stamps must not
+// decrease, a sample older than the newest one restarts the buffer (e.g. a bag restart). Each
+// slot is published under its own sequence number as a seqlock, the stamp and the sample are
+// kept in atomic words, and a read returns false if the writer overwrote the slot meanwhile,
+// the lookups then retry on the samples left in the ring.
+template <typename T>
+class TimedRingBuffer
+{
+public:
+  explicit TimedRingBuffer(int capacity) : capacity_(capacity), slotSeqs_(capacity), times_(capacity),
+                                           words_(capacity * sampleWords), lastTime_(0), first_(0), count_(0)
+  {
+    for (int i = 0; i < capacity; i++) {
+      slotSeqs_[i].store(-1, std::memory_order_relaxed);
+    }
+  }
+
+  int capacity() const
+  {
+    return capacity_;
+  }
+
+  // called by the writer
+  void push(double time, const T& sample)
+  {
+    int64_t count = count_.load(std::memory_order_relaxed);
+    if (count > first_.load(std::memory_order_relaxed) && time < lastTime_) {
+      first_.store(count, std::memory_order_relaxed);
+    }
+    lastTime_ = time;
+
+    write(count, time, sample);
+    count_.store(count + 1, std::memory_order_release);
+  }
+
+  // replaces the sample of seq keeping its stamp, called by the writer
+  void set(int64_t seq, const T& sample)
+  {
+    if (slotSeqs_[seq % capacity_].load(std::memory_order_relaxed) == seq) {
+      write(seq, times_[seq % capacity_].load(std::memory_order_relaxed), sample);
+    }
+  }
+
+  void clear()
+  {
+    first_.store(count_.load(std::memory_order_relaxed), std::memory_order_release);
+  }
+
+  bool empty() const
+  {
+    return newest() < oldest();
+  }
+
+  // sequence numbers of the newest and the oldest sample, newest() < oldest() if empty
+  int64_t newest() const
+  {
+    return count_.load(std::memory_order_acquire) - 1;
+  }
+
+  int64_t oldest() const
+  {
+    int64_t count = count_.load(std::memory_order_acquire);
+    int64_t first = first_.load(std::memory_order_acquire);
+    return count - capacity_ > first ? count - capacity_ : first;
+  }
+
+  // copies the stamp and the sample of seq, false if seq is not in the slot (anymore)
+  bool read(int64_t seq, double& time) const
+  {
+    return readSlot(seq, time, NULL);
+  }
+
+  bool read(int64_t seq, double& time, T& sample) const
+  {
+    return readSlot(seq, time, &sample);
+  }
+
+  // first sample with a stamp not before time, newest() + 1 if there is none
+  int64_t lowerBound(double time) const
+  {
+    int64_t seq;
+    while (!search(time, oldest(), newest() + 1, seq));
+    return seq;
+  }
+
+  // sample closest in time, the newer one on a tie, false if empty
+  bool nearest(double time, int64_t& seq, T& sample) const
+  {
+    for (;;) {
+      int64_t oldestSeq = oldest(), newestSeq = newest();
+      if (newestSeq < oldestSeq) return false;
+
+      double time1, time2;
+      T sample1;
+      if (!search(time, oldestSeq, newestSeq + 1, seq)) continue;
+      if (seq > newestSeq) {
+        seq = newestSeq;
+        if (read(seq, time2, sample)) return true;
+      } else if (!read(seq, time2, sample)) {
+        continue;
+      } else if (seq == oldestSeq) {
+        return true;
+      } else if (read(seq - 1, time1, sample1)) {
+        if (fabs(time - time1) < fabs(time - time2)) {
+          seq--;
+          sample = sample1;
+        }
+        return true;
+      }
+    }
+  }
+
+protected:
+  // lower bound over [low, high), false if a slot was overwritten during the search
+  bool search(double time, int64_t low, int64_t high, int64_t& seq) const
+  {
+    while (low < high) {
+      int64_t mid = low + (high - low) / 2;
+      double midTime;
+      if (!read(mid, midTime)) return false;
+      if (midTime < time) low = mid + 1;
+      else high = mid;
+    }
+    seq = low;
+    return true;
+  }
+
+private:
+  static const int sampleWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+  void write(int64_t seq, double time, const T& sample)
+  {
+    int slot = seq % capacity_;
+    uint64_t words[sampleWords] = {0};
+    memcpy(words, &sample, sizeof(T));
+
+    slotSeqs_[slot].store(-1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    times_[slot].store(time, std::memory_order_relaxed);
+    for (int i = 0; i < sampleWords; i++) {
+      words_[slot * sampleWords + i].store(words[i], std::memory_order_relaxed);
+    }
+    slotSeqs_[slot].store(seq, std::memory_order_release);
+  }
+
+  bool readSlot(int64_t seq, double& time, T *sample) const
+  {
+    int slot = seq % capacity_;
+    if (slotSeqs_[slot].load(std::memory_order_acquire) != seq) return false;
+
+    time = times_[slot].load(std::memory_order_relaxed);
+    uint64_t words[sampleWords];
+    if (sample != NULL) {
+      for (int i = 0; i < sampleWords; i++) {
+        words[i] = words_[slot * sampleWords + i].load(std::memory_order_relaxed);
+      }
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slotSeqs_[slot].load(std::memory_order_relaxed) != seq) return false;
+
+    if (sample != NULL) memcpy(sample, words, sizeof(T));
+    return true;
+  }
+
+  static_assert(std::is_trivially_copyable<T>::value, "samples are copied as words");
+
+  int capacity_;
+  std::vector<std::atomic<int64_t>> slotSeqs_;
+  std::vector<std::atomic<double>> times_;
+  std::vector<std::atomic<uint64_t>> words_;
+  double lastTime_;
+  std::atomic<int64_t> first_;
+  std::atomic<int64_t> count_;
+};
+
+// roll/pitch/yaw as used for the vehicle, rotating about x, then y, then z, the quaternion is
+// kept alongside for interpolation
+struct PoseSample
+{
+  float roll;
+  float pitch;
+  float yaw;
+  float x;
+  float y;
+  float z;
+  float qw;
+  float qx;
+  float qy;
+  float qz;
+};
+
+inline void setPoseRotation(PoseSample& pose, float roll, float pitch, float yaw)
+{
+  pose.roll = roll;
+  pose.pitch = pitch;
+  pose.yaw = yaw;
+
+  double cr = cos(0.5 * roll), sr = sin(0.5 * roll);
+  double cp = cos(0.5 * pitch), sp = sin(0.5 * pitch);
+  double cy = cos(0.5 * yaw), sy = sin(0.5 * yaw);
+  pose.qw = cr * cp * cy + sr * sp * sy;
+  pose.qx = sr * cp * cy - cr * sp * sy;
+  pose.qy = cr * sp * cy + sr * cp * sy;
+  pose.qz = cr * cp * sy - sr * sp * cy;
+}
+
+inline void setPoseQuaternion(PoseSample& pose, double qw, double qx, double qy, double qz)
+{
+  pose.qw = qw;
+  pose.qx = qx;
+  pose.qy = qy;
+  pose.qz = qz;
+
+  double sinPitch = 2.0 * (qw * qy - qz * qx);
+  if (sinPitch > 1.0) sinPitch = 1.0;
+  else if (sinPitch < -1.0) sinPitch = -1.0;
+  pose.roll = atan2(2.0 * (qw * qx + qy * qz), 1.0 - 2.0 * (qx * qx + qy * qy));
+  pose.pitch = asin(sinPitch);
+  pose.yaw = atan2(2.0 * (qw * qz + qx * qy), 1.0 - 2.0 * (qy * qy + qz * qz));
+}
+
+// position interpolated linearly and attitude by SLERP
+inline void interpolatePose(const PoseSample& pose1, const PoseSample& pose2, double ratio, PoseSample& pose)
+{
+  double qw2 = pose2.qw, qx2 = pose2.qx, qy2 = pose2.qy, qz2 = pose2.qz;
+  double dot = pose1.qw * qw2 + pose1.qx * qx2 + pose1.qy * qy2 + pose1.qz * qz2;
+  if (dot < 0) {
+    dot = -dot;
+    qw2 = -qw2;
+    qx2 = -qx2;
+    qy2 = -qy2;
+    qz2 = -qz2;
+  }
+
+  double weight1 = 1.0 - ratio, weight2 = ratio;
+  if (dot < 0.9995) {
+    double angle = acos(dot);
+    double sinAngle = sin(angle);
+    weight1 = sin((1.0 - ratio) * angle) / sinAngle;
+    weight2 = sin(ratio * angle) / sinAngle;
+  }
+
+  double qw = weight1 * pose1.qw + weight2 * qw2;
+  double qx = weight1 * pose1.qx + weight2 * qx2;
+  double qy = weight1 * pose1.qy + weight2 * qy2;
+  double qz = weight1 * pose1.qz + weight2 * qz2;
+  double norm = sqrt(qw * qw + qx * qx + qy * qy + qz * qz);
+  setPoseQuaternion(pose, qw / norm, qx / norm, qy / norm, qz / norm);
+
+  pose.x = pose1.x + ratio * (pose2.x - pose1.x);
+  pose.y = pose1.y + ratio * (pose2.y - pose1.y);
+  pose.z = pose1.z + ratio * (pose2.z - pose1.z);
+}
+
+class PoseBuffer : public TimedRingBuffer<PoseSample>
+{
+public:
+  explicit PoseBuffer(int capacity) : TimedRingBuffer<PoseSample>(capacity) {}
+
+  void push(double time, float roll, float pitch, float yaw, float x, float y, float z)
+  {
+    PoseSample pose;
+    setPoseRotation(pose, roll, pitch, yaw);
+    pose.x = x;
+    pose.y = y;
+    pose.z = z;
+    TimedRingBuffer<PoseSample>::push(time, pose);
+  }
+
+  // pose at time, held at the oldest or newest sample outside the buffered range, a stamp
+  // matching a sample returns it unchanged, returns false if empty
+  bool interpolate(double time, PoseSample& pose) const
+  {
+    for (;;) {
+      int64_t oldestSeq = oldest(), newestSeq = newest();
+      if (newestSeq < oldestSeq) return false;
+
+      int64_t seq;
+      double time1, time2;
+      PoseSample pose1, pose2;
+      if (!search(time, oldestSeq, newestSeq + 1, seq)) continue;
+      if (seq > newestSeq) {
+        if (read(newestSeq, time2, pose)) return true;
+      } else if (!read(seq, time2, pose2)) {
+        continue;
+      } else if (seq == oldestSeq || time2 == time) {
+        pose = pose2;
+        return true;
+      } else if (read(seq - 1, time1, pose1)) {
+        interpolatePose(pose1, pose2, (time - time1) / (time2 - time1), pose);
+        return true;
+      }
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,232 @@
+#ifndef LOCAL_PLANNER_ROLLING_OCCUPANCY_MAP_H
+#define LOCAL_PLANNER_ROLLING_OCCUPANCY_MAP_H
+
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+
+// Vehicle-centred voxel map of fixed size. Cells are addressed by their world index modulo the
+// map dimensions, so recentring only clears the slices that leave the map. Each cell keeps a
+// hit count that decays lazily by one every decayFrames frames (0 disables decay) and the mean
+// of the points that hit it. Occupied cells are kept in a list, so queries touch only those.
+class RollingOccupancyMap
+{
+public:
+  RollingOccupancyMap() : cellSize_(0.1), invCellSize_(10.0), decayFrames_(0), minHits_(1), maxHits_(255),
+                          frameCount_(0), initialized_(false)
+  {
+    for (int i = 0; i < 3; i++) {
+      halfDim_[i] = 0;
+      dim_[i] = 1;
+      origin_[i] = 0;
+    }
+  }
+
+  void init(float cellSize, float horiRadius, float vertRadius, int decayFrames, int minHits, int maxHits)
+  {
+    cellSize_ = cellSize;
+    invCellSize_ = 1.0 / cellSize;
+    decayFrames_ = decayFrames > 0 ? decayFrames : 0;
+    minHits_ = minHits > 1 ? minHits : 1;
+    maxHits_ = maxHits > minHits_ ? maxHits : minHits_;
+    if (maxHits_ > 65535) maxHits_ = 65535;
+
+    halfDim_[0] = halfDim_[1] = int(ceil(horiRadius * invCellSize_));
+    halfDim_[2] = int(ceil(vertRadius * invCellSize_));
+    for (int i = 0; i < 3; i++) dim_[i] = 2 * halfDim_[i] + 1;
+
+    int cellNum = dim_[0] * dim_[1] * dim_[2];
+    hits_.assign(cellNum, 0);
+    lastFrame_.assign(cellNum, 0);
+    meanX_.assign(cellNum, 0);
+    meanY_.assign(cellNum, 0);
+    meanZ_.assign(cellNum, 0);
+    pointNum_.assign(cellNum, 0);
+    listed_.assign(cellNum, 0);
+    occupied_.clear();
+    occupied_.reserve(cellNum);
+    initialized_ = false;
+  }
+
+  void clear()
+  {
+    int occupiedNum = occupied_.size();
+    for (int i = 0; i < occupiedNum; i++) {
+      resetCell(occupied_[i]);
+      listed_[occupied_[i]] = 0;
+    }
+    occupied_.clear();
+  }
+
+  // recentres the map on the vehicle, cells leaving the map are cleared
+  void moveTo(float x, float y, float z)
+  {
+    int center[3] = {cellIndex(x), cellIndex(y), cellIndex(z)};
+    int origin[3];
+    for (int i = 0; i < 3; i++) origin[i] = center[i] - halfDim_[i];
+
+    if (!initialized_) {
+      for (int i = 0; i < 3; i++) origin_[i] = origin[i];
+      initialized_ = true;
+      return;
+    }
+
+    for (int axis = 0; axis < 3; axis++) {
+      int shift = origin[axis] - origin_[axis];
+      if (shift == 0) continue;
+
+      if (shift >= dim_[axis] || -shift >= dim_[axis]) {
+        clear();
+        for (int i = 0; i < 3; i++) origin_[i] = origin[i];
+        return;
+      }
+
+      int leaveStart = shift > 0 ? origin_[axis] : origin[axis] + dim_[axis];
+      int leaveNum = shift > 0 ? shift : -shift;
+      for (int i = 0; i < leaveNum; i++) {
+        clearSlice(axis, wrap(leaveStart + i, axis));
+      }
+      origin_[axis] = origin[axis];
+    }
+  }
+
+  void nextFrame()
+  {
+    frameCount_++;
+  }
+
+  void insert(float x, float y, float z)
+  {
+    int ind[3] = {cellIndex(x), cellIndex(y), cellIndex(z)};
+    for (int i = 0; i < 3; i++) {
+      if (ind[i] < origin_[i] || ind[i] >= origin_[i] + dim_[i]) return;
+    }
+
+    int cell = dim_[1] * dim_[2] * wrap(ind[0], 0) + dim_[2] * wrap(ind[1], 1) + wrap(ind[2], 2);
+    int hits = decayedHits(cell);
+    if (hits == 0) {
+      meanX_[cell] = x;
+      meanY_[cell] = y;
+      meanZ_[cell] = z;
+      pointNum_[cell] = 1;
+    } else {
+      if (pointNum_[cell] < 255) pointNum_[cell]++;
+      float weight = 1.0 / pointNum_[cell];
+      meanX_[cell] += weight * (x - meanX_[cell]);
+      meanY_[cell] += weight * (y - meanY_[cell]);
+      meanZ_[cell] += weight * (z - meanZ_[cell]);
+    }
+
+    hits_[cell] = hits < maxHits_ ? hits + 1 : maxHits_;
+    lastFrame_[cell] = frameCount_;
+
+    if (!listed_[cell]) {
+      listed_[cell] = 1;
+      occupied_.push_back(cell);
+    }
+  }
+
+  // appends the occupied cells within the given cylinder around the centre, cells outside the
+  // cylinder or whose hits decayed to zero are cleared, as a kept cloud cropped to the cylinder
+  // each frame would lose them
+  template <typename CloudT>
+  void appendOccupied(CloudT& cloud, float centerX, float centerY, float centerZ, float horiDis, float vertDis)
+  {
+    typename CloudT::PointType point;
+    int keepNum = 0;
+    int occupiedNum = occupied_.size();
+    for (int i = 0; i < occupiedNum; i++) {
+      int cell = occupied_[i];
+      int hits = decayedHits(cell);
+      float disX = meanX_[cell] - centerX;
+      float disY = meanY_[cell] - centerY;
+      float disZ = meanZ_[cell] - centerZ;
+      if (hits == 0 || !(sqrt(disX * disX + disY * disY) < horiDis && fabs(disZ) < vertDis)) {
+        resetCell(cell);
+        listed_[cell] = 0;
+        continue;
+      }
+      occupied_[keepNum++] = cell;
+
+      if (hits < minHits_) continue;
+
+      point.x = meanX_[cell];
+      point.y = meanY_[cell];
+      point.z = meanZ_[cell];
+      cloud.push_back(point);
+    }
+    occupied_.resize(keepNum);
+  }
+
+  int occupiedSize() const
+  {
+    return occupied_.size();
+  }
+
+private:
+  int cellIndex(float x) const
+  {
+    return int(floor(x * invCellSize_));
+  }
+
+  int wrap(int ind, int axis) const
+  {
+    int slot = ind % dim_[axis];
+    return slot < 0 ? slot + dim_[axis] : slot;
+  }
+
+  int decayedHits(int cell) const
+  {
+    int hits = hits_[cell];
+    if (decayFrames_ > 0 && hits > 0) {
+      int decay = (frameCount_ - lastFrame_[cell]) / decayFrames_;
+      hits = decay < hits ? hits - decay : 0;
+    }
+    return hits;
+  }
+
+  void resetCell(int cell)
+  {
+    hits_[cell] = 0;
+    pointNum_[cell] = 0;
+  }
+
+  // listed cells stay in occupied_ and are dropped on the next appendOccupied()
+  void clearSlice(int axis, int slot)
+  {
+    int range[3][2] = {{0, dim_[0]}, {0, dim_[1]}, {0, dim_[2]}};
+    range[axis][0] = slot;
+    range[axis][1] = slot + 1;
+
+    for (int i = range[0][0]; i < range[0][1]; i++) {
+      for (int j = range[1][0]; j < range[1][1]; j++) {
+        int cell = dim_[1] * dim_[2] * i + dim_[2] * j + range[2][0];
+        for (int k = range[2][0]; k < range[2][1]; k++) {
+          resetCell(cell++);
+        }
+      }
+    }
+  }
+
+  float cellSize_;
+  float invCellSize_;
+  int decayFrames_;
+  int minHits_;
+  int maxHits_;
+  int halfDim_[3];
+  int dim_[3];
+  int origin_[3];
+  uint32_t frameCount_;
+  bool initialized_;
+
+  std::vector<uint16_t> hits_;
+  std::vector<uint32_t> lastFrame_;
+  std::vector<float> meanX_;
+  std::vector<float> meanY_;
+  std::vector<float> meanZ_;
+  std::vector<uint8_t> pointNum_;
+  std::vector<uint8_t> listed_;
+  std::vector<int> occupied_;
+};
+
+#endif
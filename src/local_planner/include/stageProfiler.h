@@ -0,0 +1,290 @@
+#ifndef LOCAL_PLANNER_STAGE_PROFILER_H
+#define LOCAL_PLANNER_STAGE_PROFILER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Per-stage timing histograms, recorded lock-free from any thread and read out periodically.
+// Durations are binned log-linearly in ns, 8 bins per power of two, so percentiles are within
+// about 6%. Optionally every recorded span is also written to a Chrome trace file
+// (chrome://tracing, Perfetto), buffered in memory and written by flushTrace().
+struct StageStats
+{
+  uint64_t count;
+  double meanMs;
+  double p50Ms;
+  double p99Ms;
+  double maxMs;
+};
+
+class StageProfiler
+{
+public:
+  StageProfiler() : enabled_(false), stageNum_(0), traceFile_(NULL), traceEventNum_(0) {}
+
+  ~StageProfiler()
+  {
+    closeTrace();
+  }
+
+  void init(const char *const *stageNames, int stageNum)
+  {
+    stageNum_ = stageNum < maxStageNum ? stageNum : maxStageNum;
+    for (int i = 0; i < stageNum_; i++) {
+      stageNames_[i] = stageNames[i];
+      resetStage(i);
+    }
+    enabled_ = true;
+  }
+
+  bool enabled() const
+  {
+    return enabled_;
+  }
+
+  int stageNum() const
+  {
+    return stageNum_;
+  }
+
+  const std::string& stageName(int stage) const
+  {
+    return stageNames_[stage];
+  }
+
+  static int64_t nowNs()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  void record(int stage, int64_t startNs, int64_t durationNs)
+  {
+    if (durationNs < 0) durationNs = 0;
+    Stage& s = stages_[stage];
+    s.bins[binIndex(durationNs)].fetch_add(1, std::memory_order_relaxed);
+    s.count.fetch_add(1, std::memory_order_relaxed);
+    s.sumNs.fetch_add(durationNs, std::memory_order_relaxed);
+
+    int64_t maxNs = s.maxNs.load(std::memory_order_relaxed);
+    while (durationNs > maxNs && !s.maxNs.compare_exchange_weak(maxNs, durationNs, std::memory_order_relaxed)) {}
+
+    if (traceFile_ != NULL) {
+      TraceEvent event = {stage, threadID(), startNs, durationNs};
+      std::lock_guard<std::mutex> lock(traceMutex_);
+      traceEvents_.push_back(event);
+    }
+  }
+
+  // statistics since the last call, the stage is reset
+  void snapshot(int stage, StageStats& stats)
+  {
+    Stage& s = stages_[stage];
+    uint32_t bins[binNum];
+    uint64_t count = 0;
+    for (int i = 0; i < binNum; i++) {
+      bins[i] = s.bins[i].exchange(0, std::memory_order_relaxed);
+      count += bins[i];
+    }
+    s.count.store(0, std::memory_order_relaxed);
+    int64_t sumNs = s.sumNs.exchange(0, std::memory_order_relaxed);
+    int64_t maxNs = s.maxNs.exchange(0, std::memory_order_relaxed);
+
+    stats.count = count;
+    stats.meanMs = count > 0 ? 1.0e-6 * sumNs / count : 0;
+    stats.p50Ms = 1.0e-6 * percentileNs(bins, count, 0.5);
+    stats.p99Ms = 1.0e-6 * percentileNs(bins, count, 0.99);
+    stats.maxMs = 1.0e-6 * maxNs;
+  }
+
+  bool openTrace(const std::string& fileName)
+  {
+    traceFile_ = fopen(fileName.c_str(), "w");
+    if (traceFile_ == NULL) {
+      return false;
+    }
+
+    fprintf(traceFile_, "[\n");
+    traceEventNum_ = 0;
+    return true;
+  }
+
+  void flushTrace()
+  {
+    if (traceFile_ == NULL) {
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(traceMutex_);
+      traceEvents_.swap(traceWriteEvents_);
+    }
+
+    int pid = getpid();
+    int eventNum = traceWriteEvents_.size();
+    for (int i = 0; i < eventNum; i++) {
+      const TraceEvent& event = traceWriteEvents_[i];
+      fprintf(traceFile_, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+              traceEventNum_ > 0 ? ",\n" : "", stageNames_[event.stage].c_str(), pid, event.threadID,
+              1.0e-3 * event.startNs, 1.0e-3 * event.durationNs);
+      traceEventNum_++;
+    }
+    traceWriteEvents_.clear();
+    fflush(traceFile_);
+  }
+
+  void closeTrace()
+  {
+    if (traceFile_ == NULL) {
+      return;
+    }
+
+    flushTrace();
+    fprintf(traceFile_, "\n]\n");
+    fclose(traceFile_);
+    traceFile_ = NULL;
+  }
+
+private:
+  static const int maxStageNum = 32;
+  static const int binNum = 320;
+
+  struct Stage
+  {
+    std::atomic<uint32_t> bins[binNum];
+    std::atomic<uint64_t> count;
+    std::atomic<int64_t> sumNs;
+    std::atomic<int64_t> maxNs;
+  };
+
+  struct TraceEvent
+  {
+    int stage;
+    int threadID;
+    int64_t startNs;
+    int64_t durationNs;
+  };
+
+  // values below 8 ns get one bin each, above that each power of two is split into 8 bins
+  static int binIndex(int64_t ns)
+  {
+    if (ns < 8) return ns;
+    int octave = 63 - __builtin_clzll(uint64_t(ns));
+    int bin = 8 * (octave - 2) + int((ns >> (octave - 3)) & 7);
+    return bin < binNum ? bin : binNum - 1;
+  }
+
+  static double binCenterNs(int bin)
+  {
+    if (bin < 8) return bin;
+    int octave = bin / 8 + 2;
+    double width = double(int64_t(1) << (octave - 3));
+    return (8 + bin % 8) * width + 0.5 * width;
+  }
+
+  static double percentileNs(const uint32_t *bins, uint64_t count, double fraction)
+  {
+    if (count == 0) return 0;
+
+    uint64_t rank = uint64_t(fraction * count + 0.5);
+    if (rank < 1) rank = 1;
+    uint64_t accumulated = 0;
+    for (int i = 0; i < binNum; i++) {
+      accumulated += bins[i];
+      if (accumulated >= rank) return binCenterNs(i);
+    }
+    return binCenterNs(binNum - 1);
+  }
+
+  static int threadID()
+  {
+    static std::atomic<int> threadCount(0);
+    thread_local int id = ++threadCount;
+    return id;
+  }
+
+  void resetStage(int stage)
+  {
+    Stage& s = stages_[stage];
+    for (int i = 0; i < binNum; i++) s.bins[i].store(0, std::memory_order_relaxed);
+    s.count.store(0, std::memory_order_relaxed);
+    s.sumNs.store(0, std::memory_order_relaxed);
+    s.maxNs.store(0, std::memory_order_relaxed);
+  }
+
+  bool enabled_;
+  int stageNum_;
+  std::string stageNames_[maxStageNum];
+  Stage stages_[maxStageNum];
+
+  FILE *traceFile_;
+  int64_t traceEventNum_;
+  std::mutex traceMutex_;
+  std::vector<TraceEvent> traceEvents_;
+  std::vector<TraceEvent> traceWriteEvents_;
+};
+
+// key/value pair added to a diagnostic_msgs::DiagnosticStatus, which is a template parameter so
+// that this header stays free of ROS
+template <typename DiagnosticStatusT>
+void addDiagnosticValue(DiagnosticStatusT& status, const char *key, const char *value)
+{
+  typename DiagnosticStatusT::_values_type::value_type keyValue;
+  keyValue.key = key;
+  keyValue.value = value;
+  status.values.push_back(keyValue);
+}
+
+template <typename DiagnosticStatusT>
+void addDiagnosticValue(DiagnosticStatusT& status, const char *key, double value)
+{
+  char str[32];
+  snprintf(str, sizeof(str), "%.3f", value);
+  addDiagnosticValue(status, key, str);
+}
+
+template <typename DiagnosticStatusT>
+void addDiagnosticValue(DiagnosticStatusT& status, const char *key, uint64_t value)
+{
+  char str[32];
+  snprintf(str, sizeof(str), "%llu", (unsigned long long)value);
+  addDiagnosticValue(status, key, str);
+}
+
+// times the enclosing scope or up to stop(), nothing is read from the clock while the
+// profiler is disabled
+class ScopedStageTimer
+{
+public:
+  ScopedStageTimer(StageProfiler& profiler, int stage)
+    : profiler_(profiler), stage_(stage), running_(profiler.enabled()), startNs_(running_ ? StageProfiler::nowNs() : 0)
+  {
+  }
+
+  ~ScopedStageTimer()
+  {
+    stop();
+  }
+
+  void stop()
+  {
+    if (running_) {
+      profiler_.record(stage_, startNs_, StageProfiler::nowNs() - startNs_);
+      running_ = false;
+    }
+  }
+
+private:
+  StageProfiler& profiler_;
+  int stage_;
+  bool running_;
+  int64_t startNs_;
+};
+
+#endif
@@ -0,0 +1,137 @@
+#ifndef LOCAL_PLANNER_TEMPORAL_VOXEL_FILTER_H
+#define LOCAL_PLANNER_TEMPORAL_VOXEL_FILTER_H
+
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+
+// Drops scan points whose voxel was not seen in at least minHits of the last frameNum frames
+// (up to 32), which removes single-frame noise and fast moving objects before they reach the
+// planner. Points within passDis of the vehicle always pass. The hit history of each voxel is
+// a bitmask, shifted lazily on access, in a hash table of fixed size allocated by init().
+// Lookups probe a bounded number of slots and take over the stalest one if the voxel is not
+// found, so memory and time per point stay fixed however long the vehicle drives. A slot hit
+// in the current frame is never taken over, if all probed slots were hit the point passes
+// unfiltered rather than evicting a voxel that is being seen.
+class TemporalVoxelFilter
+{
+public:
+  TemporalVoxelFilter() : invLeafSize_(10.0), frameNum_(5), minHits_(3), passDisSq_(0), slotMask_(0), frameCount_(0) {}
+
+  void init(float leafSize, int frameNum, int minHits, float passDis, int slotNum)
+  {
+    invLeafSize_ = 1.0 / leafSize;
+    frameNum_ = frameNum < 1 ? 1 : (frameNum > 32 ? 32 : frameNum);
+    minHits_ = minHits < 1 ? 1 : (minHits > frameNum_ ? frameNum_ : minHits);
+    passDisSq_ = passDis * passDis;
+
+    int size = 1;
+    while (size < slotNum) size *= 2;
+    slotMask_ = size - 1;
+    keys_.assign(size, 0);
+    history_.assign(size, 0);
+    lastFrame_.assign(size, 0);
+    frameCount_ = 0;
+  }
+
+  // filters the cloud in place, transform is a row-major 3x4 transform to the world frame or
+  // NULL if the cloud is in the world frame, vehicleX/Y/Z is in the world frame
+  template <typename CloudT>
+  void filter(CloudT& cloud, const float *transform, float vehicleX, float vehicleY, float vehicleZ)
+  {
+    frameCount_++;
+
+    int pointNum = cloud.points.size();
+    int keptNum = 0;
+    for (int i = 0; i < pointNum; i++) {
+      float x = cloud.points[i].x;
+      float y = cloud.points[i].y;
+      float z = cloud.points[i].z;
+      if (transform != NULL) {
+        float worldX = transform[0] * x + transform[1] * y + transform[2] * z + transform[3];
+        float worldY = transform[4] * x + transform[5] * y + transform[6] * z + transform[7];
+        float worldZ = transform[8] * x + transform[9] * y + transform[10] * z + transform[11];
+        x = worldX;
+        y = worldY;
+        z = worldZ;
+      }
+
+      uint32_t history = addHit(voxelKey(x, y, z));
+      float disX = x - vehicleX;
+      float disY = y - vehicleY;
+      float disZ = z - vehicleZ;
+      if (__builtin_popcount(history) >= minHits_ || disX * disX + disY * disY + disZ * disZ < passDisSq_) {
+        cloud.points[keptNum++] = cloud.points[i];
+      }
+    }
+
+    cloud.points.resize(keptNum);
+    cloud.width = keptNum;
+    cloud.height = 1;
+  }
+
+private:
+  static const int maxProbeNum = 8;
+
+  uint64_t voxelKey(float x, float y, float z) const
+  {
+    int64_t indX = int64_t(floor(x * invLeafSize_));
+    int64_t indY = int64_t(floor(y * invLeafSize_));
+    int64_t indZ = int64_t(floor(z * invLeafSize_));
+    return (uint64_t(indX & 0x1FFFFF) << 42) | (uint64_t(indY & 0x1FFFFF) << 21) | uint64_t(indZ & 0x1FFFFF) |
+           (uint64_t(1) << 63);
+  }
+
+  // history of the voxel over the last frameNum frames including this one, bit 0 is this frame,
+  // all frames set if the voxel has no slot and all probed slots are in use this frame
+  uint32_t addHit(uint64_t key)
+  {
+    uint32_t slot = uint32_t((key * 0x9E3779B97F4A7C15ULL) >> 32) & slotMask_;
+    int victim = slot;
+    uint32_t victimAge = 0;
+    for (int i = 0; i < maxProbeNum; i++) {
+      uint32_t probe = (slot + i) & slotMask_;
+      if (keys_[probe] == key) {
+        uint32_t age = frameCount_ - lastFrame_[probe];
+        uint32_t history = age >= 32 ? 0 : history_[probe] << age;
+        history = (history | 1) & windowMask();
+        history_[probe] = history;
+        lastFrame_[probe] = frameCount_;
+        return history;
+      }
+
+      uint32_t age = keys_[probe] == 0 ? 0xFFFFFFFF : frameCount_ - lastFrame_[probe];
+      if (age > victimAge) {
+        victim = probe;
+        victimAge = age;
+      }
+    }
+
+    if (victimAge == 0) {
+      return windowMask();
+    }
+
+    // the stalest probed slot is taken over
+    keys_[victim] = key;
+    history_[victim] = 1;
+    lastFrame_[victim] = frameCount_;
+    return 1;
+  }
+
+  uint32_t windowMask() const
+  {
+    return frameNum_ >= 32 ? 0xFFFFFFFF : (uint32_t(1) << frameNum_) - 1;
+  }
+
+  float invLeafSize_;
+  int frameNum_;
+  int minHits_;
+  float passDisSq_;
+  uint32_t slotMask_;
+  uint32_t frameCount_;
+  std::vector<uint64_t> keys_;
+  std::vector<uint32_t> history_;
+  std::vector<uint32_t> lastFrame_;
+};
+
+#endif
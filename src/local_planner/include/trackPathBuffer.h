@@ -0,0 +1,143 @@
+#ifndef LOCAL_PLANNER_TRACK_PATH_BUFFER_H
+#define LOCAL_PLANNER_TRACK_PATH_BUFFER_H
+
+#include <math.h>
+#include <utility>
+#include <vector>
+
+// positions are kept in double as in the path messages the points come from, heading,
+// horizontal length and slope refer to the segment from the previous point, curvature is the
+// heading change to the next segment over the length of this one
+struct TrackPoint
+{
+  double x;
+  double y;
+  double z;
+  float yaw;
+  float dis;
+  float slope;
+  float curv;
+};
+
+// Followed trajectory as a ring of points with stable indices. Points keep their index for as
+// long as they are held, the points from begin() to end() - 1 are held, and once the ring is full
+// appending a point drops the oldest one. Splicing a path truncates after the point it starts
+// from and appends the rest, so it costs the path length however long the trajectory gets. The
+// segment geometry of each point is computed as it is added, so following the path needs no
+// trigonometry.
+class TrackPathBuffer
+{
+public:
+  TrackPathBuffer() : begin_(0), end_(0) {}
+
+  explicit TrackPathBuffer(int capacity) : points_(capacity), begin_(0), end_(0) {}
+
+  void reset(double x, double y, double z)
+  {
+    begin_ = end_ = 0;
+    push(x, y, z);
+  }
+
+  int begin() const
+  {
+    return begin_;
+  }
+
+  int end() const
+  {
+    return end_;
+  }
+
+  bool contains(int id) const
+  {
+    return id >= begin_ && id < end_;
+  }
+
+  TrackPoint& operator[](int id)
+  {
+    return points_[id % points_.size()];
+  }
+
+  const TrackPoint& operator[](int id) const
+  {
+    return points_[id % points_.size()];
+  }
+
+  void swap(TrackPathBuffer& other)
+  {
+    points_.swap(other.points_);
+    std::swap(begin_, other.begin_);
+    std::swap(end_, other.end_);
+  }
+
+  // drops the points from id on
+  void truncate(int id)
+  {
+    if (id < begin_) id = begin_;
+    if (id < end_) end_ = id;
+  }
+
+  void push(double x, double y, double z)
+  {
+    TrackPoint& point = points_[end_ % points_.size()];
+    point.x = x;
+    point.y = y;
+    point.z = z;
+    end_++;
+    if (end_ - begin_ > int(points_.size())) begin_++;
+    updateGeometry(end_ - 1);
+  }
+
+  // recomputes the geometry after the position of the point is changed
+  void set(int id, double x, double y, double z)
+  {
+    TrackPoint& point = (*this)[id];
+    point.x = x;
+    point.y = y;
+    point.z = z;
+    updateGeometry(id);
+    if (id + 1 < end_) updateGeometry(id + 1);
+  }
+
+private:
+  // the follower reads the track point as float, the heading from the previous point is taken
+  // from there while the heading to the next point is taken between the double positions,
+  // with the same float arithmetic as when the follower computed these per cycle
+  void updateGeometry(int id)
+  {
+    TrackPoint& point = (*this)[id];
+    point.curv = 0;
+    if (id <= begin_) {
+      point.yaw = 0;
+      point.dis = 0;
+      point.slope = 0;
+      return;
+    }
+
+    TrackPoint& prevPoint = (*this)[id - 1];
+    float deltaX = float(point.x) - prevPoint.x;
+    float deltaY = float(point.y) - prevPoint.y;
+    float deltaZ = float(point.z) - prevPoint.z;
+    point.yaw = atan2(deltaY, deltaX);
+    point.dis = sqrt(deltaX * deltaX + deltaY * deltaY);
+    point.slope = point.dis > 0.001 ? deltaZ / point.dis : 0;
+
+    if (id - 1 > begin_ && prevPoint.dis > 0.001) {
+      float nextDeltaX = point.x - prevPoint.x;
+      float nextDeltaY = point.y - prevPoint.y;
+      float nextYaw = atan2(nextDeltaY, nextDeltaX);
+
+      float deltaYaw = nextYaw - prevPoint.yaw;
+      if (deltaYaw > 3.1415926) deltaYaw -= 2 * 3.1415926;
+      else if (deltaYaw < -3.1415926) deltaYaw += 2 * 3.1415926;
+
+      prevPoint.curv = deltaYaw / prevPoint.dis;
+    }
+  }
+
+  std::vector<TrackPoint> points_;
+  int begin_;
+  int end_;
+};
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef LOCAL_PLANNER_TRAJECTORY_LOGGER_H
+#define LOCAL_PLANNER_TRAJECTORY_LOGGER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Binary trajectory log of pathFollower, the file starts with the magic and version followed by
+// TrajectoryRecord entries, trajectoryExport converts it to the desired and executed trajectory
+// text files.
+const uint32_t trajectoryLogMagic = 0x4c4a5254; // "TRJL"
+const uint32_t trajectoryLogVersion = 1;
+
+struct TrajectoryRecord
+{
+  double time;
+  float trackX;
+  float trackY;
+  float trackZ;
+  float trackYaw;
+  float vehicleX;
+  float vehicleY;
+  float vehicleZ;
+  float roll;
+  float pitch;
+  float yaw;
+};
+
+// log() only copies the record into a lock-free single-producer/single-consumer ring, a
+// background thread writes the ring out to the file, so logging does no I/O and takes no lock
+// on the calling thread. Records are dropped and counted if the ring is full.
+class TrajectoryLogger
+{
+public:
+  TrajectoryLogger() : filePtr_(NULL), head_(0), tail_(0), dropNum_(0), stop_(false) {}
+
+  ~TrajectoryLogger()
+  {
+    close();
+  }
+
+  bool open(const std::string& fileName, int capacity = 4096)
+  {
+    filePtr_ = fopen(fileName.c_str(), "wb");
+    if (filePtr_ == NULL) {
+      return false;
+    }
+
+    uint32_t fileHeader[2] = {trajectoryLogMagic, trajectoryLogVersion};
+    fwrite(fileHeader, sizeof(fileHeader), 1, filePtr_);
+
+    records_.resize(capacity);
+    head_ = tail_ = 0;
+    dropNum_ = 0;
+    stop_ = false;
+    writer_ = std::thread(&TrajectoryLogger::writeLoop, this);
+    return true;
+  }
+
+  bool isOpen() const
+  {
+    return filePtr_ != NULL;
+  }
+
+  void log(const TrajectoryRecord& record)
+  {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) >= records_.size()) {
+      dropNum_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    records_[head % records_.size()] = record;
+    head_.store(head + 1, std::memory_order_release);
+  }
+
+  uint64_t dropNum() const
+  {
+    return dropNum_.load(std::memory_order_relaxed);
+  }
+
+  // writes out the remaining records and closes the file
+  void close()
+  {
+    if (filePtr_ == NULL) {
+      return;
+    }
+
+    stop_ = true;
+    writer_.join();
+    fclose(filePtr_);
+    filePtr_ = NULL;
+  }
+
+private:
+  void writeLoop()
+  {
+    while (true) {
+      bool stop = stop_.load(std::memory_order_acquire);
+      uint64_t head = head_.load(std::memory_order_acquire);
+      uint64_t tail = tail_.load(std::memory_order_relaxed);
+      while (tail < head) {
+        uint64_t start = tail % records_.size();
+        uint64_t num = head - tail;
+        if (num > records_.size() - start) num = records_.size() - start;
+
+        fwrite(&records_[start], sizeof(TrajectoryRecord), num, filePtr_);
+        tail += num;
+        tail_.store(tail, std::memory_order_release);
+      }
+
+      if (stop) break;
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+
+    fflush(filePtr_);
+  }
+
+  FILE *filePtr_;
+  std::vector<TrajectoryRecord> records_;
+  std::atomic<uint64_t> head_;
+  std::atomic<uint64_t> tail_;
+  std::atomic<uint64_t> dropNum_;
+  std::atomic<bool> stop_;
+  std::thread writer_;
+};
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef LOCAL_PLANNER_VOXEL_HASH_FILTER_H
+#define LOCAL_PLANNER_VOXEL_HASH_FILTER_H
+
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+
+// Streaming voxel downsampler, replaces pcl::VoxelGrid. Points are accumulated into an
+// open-addressing hash of voxel centroids in one pass without sorting. Buckets and voxel
+// storage are kept across frames and clear() only resets the buckets that were used, so
+// after warm-up a frame does no allocation.
+class VoxelHashFilter
+{
+public:
+  VoxelHashFilter() : invLeafSize_(10.0), bucketMask_(0)
+  {
+    reserve(1024);
+  }
+
+  void setLeafSize(float leafSize)
+  {
+    invLeafSize_ = 1.0 / leafSize;
+  }
+
+  void reserve(int voxelNum)
+  {
+    if (voxelNum < 16) voxelNum = 16;
+    int bucketNum = 1;
+    while (bucketNum < 2 * voxelNum) bucketNum *= 2;
+    if (bucketNum <= int(buckets_.size())) return;
+
+    voxelKey_.reserve(voxelNum);
+    voxelBucket_.reserve(voxelNum);
+    sumX_.reserve(voxelNum);
+    sumY_.reserve(voxelNum);
+    sumZ_.reserve(voxelNum);
+    count_.reserve(voxelNum);
+    rehash(bucketNum);
+  }
+
+  void clear()
+  {
+    int voxelNum = voxelKey_.size();
+    for (int i = 0; i < voxelNum; i++) {
+      buckets_[voxelBucket_[i]] = -1;
+    }
+
+    voxelKey_.clear();
+    voxelBucket_.clear();
+    sumX_.clear();
+    sumY_.clear();
+    sumZ_.clear();
+    count_.clear();
+  }
+
+  void addPoint(float x, float y, float z)
+  {
+    if (!isfinite(x) || !isfinite(y) || !isfinite(z)) return;
+
+    uint64_t key = voxelKey(x, y, z);
+    uint32_t bucket = hashKey(key);
+    while (true) {
+      int voxel = buckets_[bucket];
+      if (voxel < 0) break;
+      if (voxelKey_[voxel] == key) {
+        sumX_[voxel] += x;
+        sumY_[voxel] += y;
+        sumZ_[voxel] += z;
+        count_[voxel]++;
+        return;
+      }
+      bucket = (bucket + 1) & bucketMask_;
+    }
+
+    int voxel = voxelKey_.size();
+    buckets_[bucket] = voxel;
+    voxelKey_.push_back(key);
+    voxelBucket_.push_back(bucket);
+    sumX_.push_back(x);
+    sumY_.push_back(y);
+    sumZ_.push_back(z);
+    count_.push_back(1);
+
+    if (2 * int(voxelKey_.size()) > int(buckets_.size())) {
+      rehash(2 * buckets_.size());
+    }
+  }
+
+  int size() const
+  {
+    return voxelKey_.size();
+  }
+
+  void getCentroid(int voxel, float& x, float& y, float& z) const
+  {
+    float invCount = 1.0 / count_[voxel];
+    x = sumX_[voxel] * invCount;
+    y = sumY_[voxel] * invCount;
+    z = sumZ_[voxel] * invCount;
+  }
+
+  // writes the voxel centroids into cloud.points, for any point type with x, y, z members
+  template <typename CloudT>
+  void getCloud(CloudT& cloud) const
+  {
+    int voxelNum = voxelKey_.size();
+    cloud.points.resize(voxelNum);
+    for (int i = 0; i < voxelNum; i++) {
+      getCentroid(i, cloud.points[i].x, cloud.points[i].y, cloud.points[i].z);
+    }
+    cloud.width = voxelNum;
+    cloud.height = 1;
+    cloud.is_dense = true;
+  }
+
+private:
+  uint64_t voxelKey(float x, float y, float z) const
+  {
+    int64_t indX = int64_t(floor(x * invLeafSize_));
+    int64_t indY = int64_t(floor(y * invLeafSize_));
+    int64_t indZ = int64_t(floor(z * invLeafSize_));
+    return (uint64_t(indX & 0x1FFFFF) << 42) | (uint64_t(indY & 0x1FFFFF) << 21) | uint64_t(indZ & 0x1FFFFF);
+  }
+
+  uint32_t hashKey(uint64_t key) const
+  {
+    return uint32_t((key * 0x9E3779B97F4A7C15ULL) >> 32) & bucketMask_;
+  }
+
+  void rehash(int bucketNum)
+  {
+    buckets_.assign(bucketNum, -1);
+    bucketMask_ = bucketNum - 1;
+
+    int voxelNum = voxelKey_.size();
+    for (int i = 0; i < voxelNum; i++) {
+      uint32_t bucket = hashKey(voxelKey_[i]);
+      while (buckets_[bucket] >= 0) bucket = (bucket + 1) & bucketMask_;
+      buckets_[bucket] = i;
+      voxelBucket_[i] = bucket;
+    }
+  }
+
+  double invLeafSize_;
+  uint32_t bucketMask_;
+  std::vector<int> buckets_;
+  std::vector<uint64_t> voxelKey_;
+  std::vector<uint32_t> voxelBucket_;
+  std::vector<float> sumX_;
+  std::vector<float> sumY_;
+  std::vector<float> sumZ_;
+  std::vector<int> count_;
+};
+
+#endif
@@ -0,0 +1,283 @@
+#ifndef LOCAL_PLANNER_VOXEL_STACK_H
+#define LOCAL_PLANNER_VOXEL_STACK_H
+
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+
+// Voxel centroids of the union of the last frameNum frames, maintained incrementally. Each
+// voxel holds the point sums of all stacked frames and the number of frames contributing to
+// it, each frame keeps its own per-voxel sums. Adding a frame inserts its points and evicts
+// the oldest frame by subtracting its sums, a voxel is removed when no frame refers to it, so
+// the union is never recomputed.
+class VoxelStack
+{
+public:
+  VoxelStack() : invLeafSize_(10.0), bucketMask_(0), frameNum_(1), frameHead_(0), frameFill_(0), frameCount_(0)
+  {
+    frames_.resize(1);
+    rehash(2048);
+  }
+
+  void setLeafSize(float leafSize)
+  {
+    invLeafSize_ = 1.0 / leafSize;
+  }
+
+  void setFrameNum(int frameNum)
+  {
+    clear();
+    frameNum_ = frameNum > 1 ? frameNum : 1;
+    frames_.assign(frameNum_, Frame());
+  }
+
+  int frameNum() const
+  {
+    return frameNum_;
+  }
+
+  void reserve(int voxelNum)
+  {
+    int bucketNum = 1;
+    while (bucketNum < 2 * voxelNum) bucketNum *= 2;
+    if (bucketNum > int(buckets_.size())) rehash(bucketNum);
+
+    for (int i = 0; i < frameNum_; i++) {
+      frames_[i].voxel.reserve(voxelNum);
+      frames_[i].sumX.reserve(voxelNum);
+      frames_[i].sumY.reserve(voxelNum);
+      frames_[i].sumZ.reserve(voxelNum);
+      frames_[i].count.reserve(voxelNum);
+    }
+  }
+
+  void clear()
+  {
+    while (frameFill_ > 0) evictFrame();
+    frameHead_ = 0;
+  }
+
+  template <typename CloudT>
+  void addFrame(const CloudT& cloud)
+  {
+    if (frameFill_ == frameNum_) evictFrame();
+
+    int frameID = (frameHead_ + frameFill_) % frameNum_;
+    Frame& frame = frames_[frameID];
+    frameFill_++;
+    frameCount_++;
+
+    int pointNum = cloud.points.size();
+    for (int i = 0; i < pointNum; i++) {
+      float x = cloud.points[i].x;
+      float y = cloud.points[i].y;
+      float z = cloud.points[i].z;
+      if (!isfinite(x) || !isfinite(y) || !isfinite(z)) continue;
+
+      int voxel = findOrInsert(voxelKey(x, y, z));
+      if (voxelStamp_[voxel] != frameCount_) {
+        voxelStamp_[voxel] = frameCount_;
+        voxelEntry_[voxel] = frame.voxel.size();
+        voxelRefs_[voxel]++;
+        frame.voxel.push_back(voxel);
+        frame.sumX.push_back(0);
+        frame.sumY.push_back(0);
+        frame.sumZ.push_back(0);
+        frame.count.push_back(0);
+      }
+
+      int entry = voxelEntry_[voxel];
+      frame.sumX[entry] += x;
+      frame.sumY[entry] += y;
+      frame.sumZ[entry] += z;
+      frame.count[entry]++;
+      sumX_[voxel] += x;
+      sumY_[voxel] += y;
+      sumZ_[voxel] += z;
+      count_[voxel]++;
+    }
+  }
+
+  int size() const
+  {
+    return liveVoxels_.size();
+  }
+
+  template <typename CloudT>
+  void getCloud(CloudT& cloud) const
+  {
+    int voxelNum = liveVoxels_.size();
+    cloud.points.resize(voxelNum);
+    for (int i = 0; i < voxelNum; i++) {
+      int voxel = liveVoxels_[i];
+      double invCount = 1.0 / count_[voxel];
+      cloud.points[i].x = sumX_[voxel] * invCount;
+      cloud.points[i].y = sumY_[voxel] * invCount;
+      cloud.points[i].z = sumZ_[voxel] * invCount;
+    }
+    cloud.width = voxelNum;
+    cloud.height = 1;
+    cloud.is_dense = true;
+  }
+
+private:
+  struct Frame
+  {
+    std::vector<int> voxel;
+    std::vector<double> sumX;
+    std::vector<double> sumY;
+    std::vector<double> sumZ;
+    std::vector<int> count;
+  };
+
+  void evictFrame()
+  {
+    Frame& frame = frames_[frameHead_];
+    int entryNum = frame.voxel.size();
+    for (int i = 0; i < entryNum; i++) {
+      int voxel = frame.voxel[i];
+      if (--voxelRefs_[voxel] == 0) {
+        removeVoxel(voxel);
+      } else {
+        sumX_[voxel] -= frame.sumX[i];
+        sumY_[voxel] -= frame.sumY[i];
+        sumZ_[voxel] -= frame.sumZ[i];
+        count_[voxel] -= frame.count[i];
+      }
+    }
+
+    frame.voxel.clear();
+    frame.sumX.clear();
+    frame.sumY.clear();
+    frame.sumZ.clear();
+    frame.count.clear();
+    frameHead_ = (frameHead_ + 1) % frameNum_;
+    frameFill_--;
+  }
+
+  uint64_t voxelKey(float x, float y, float z) const
+  {
+    int64_t indX = int64_t(floor(x * invLeafSize_));
+    int64_t indY = int64_t(floor(y * invLeafSize_));
+    int64_t indZ = int64_t(floor(z * invLeafSize_));
+    return (uint64_t(indX & 0x1FFFFF) << 42) | (uint64_t(indY & 0x1FFFFF) << 21) | uint64_t(indZ & 0x1FFFFF);
+  }
+
+  uint32_t hashKey(uint64_t key) const
+  {
+    return uint32_t((key * 0x9E3779B97F4A7C15ULL) >> 32) & bucketMask_;
+  }
+
+  int findOrInsert(uint64_t key)
+  {
+    uint32_t bucket = hashKey(key);
+    while (true) {
+      int voxel = buckets_[bucket];
+      if (voxel < 0) break;
+      if (voxelKey_[voxel] == key) return voxel;
+      bucket = (bucket + 1) & bucketMask_;
+    }
+
+    int voxel;
+    if (!freeVoxels_.empty()) {
+      voxel = freeVoxels_.back();
+      freeVoxels_.pop_back();
+    } else {
+      voxel = voxelKey_.size();
+      voxelKey_.push_back(0);
+      voxelBucket_.push_back(0);
+      voxelStamp_.push_back(0);
+      voxelEntry_.push_back(0);
+      voxelRefs_.push_back(0);
+      livePos_.push_back(0);
+      sumX_.push_back(0);
+      sumY_.push_back(0);
+      sumZ_.push_back(0);
+      count_.push_back(0);
+    }
+
+    voxelKey_[voxel] = key;
+    voxelBucket_[voxel] = bucket;
+    voxelStamp_[voxel] = 0;
+    voxelRefs_[voxel] = 0;
+    sumX_[voxel] = sumY_[voxel] = sumZ_[voxel] = 0;
+    count_[voxel] = 0;
+    livePos_[voxel] = liveVoxels_.size();
+    liveVoxels_.push_back(voxel);
+    buckets_[bucket] = voxel;
+
+    if (2 * liveVoxels_.size() > buckets_.size()) {
+      rehash(2 * buckets_.size());
+    }
+
+    return voxel;
+  }
+
+  // linear probing deletion by backward shift, no tombstones
+  void removeVoxel(int voxel)
+  {
+    uint32_t hole = voxelBucket_[voxel];
+    uint32_t bucket = hole;
+    while (true) {
+      bucket = (bucket + 1) & bucketMask_;
+      int next = buckets_[bucket];
+      if (next < 0) break;
+
+      uint32_t home = hashKey(voxelKey_[next]);
+      bool movable = hole <= bucket ? (home <= hole || home > bucket) : (home <= hole && home > bucket);
+      if (movable) {
+        buckets_[hole] = next;
+        voxelBucket_[next] = hole;
+        hole = bucket;
+      }
+    }
+    buckets_[hole] = -1;
+
+    int pos = livePos_[voxel];
+    int last = liveVoxels_.back();
+    liveVoxels_[pos] = last;
+    livePos_[last] = pos;
+    liveVoxels_.pop_back();
+    freeVoxels_.push_back(voxel);
+  }
+
+  void rehash(int bucketNum)
+  {
+    buckets_.assign(bucketNum, -1);
+    bucketMask_ = bucketNum - 1;
+
+    int voxelNum = liveVoxels_.size();
+    for (int i = 0; i < voxelNum; i++) {
+      int voxel = liveVoxels_[i];
+      uint32_t bucket = hashKey(voxelKey_[voxel]);
+      while (buckets_[bucket] >= 0) bucket = (bucket + 1) & bucketMask_;
+      buckets_[bucket] = voxel;
+      voxelBucket_[voxel] = bucket;
+    }
+  }
+
+  double invLeafSize_;
+  uint32_t bucketMask_;
+  std::vector<int> buckets_;
+
+  std::vector<uint64_t> voxelKey_;
+  std::vector<uint32_t> voxelBucket_;
+  std::vector<uint32_t> voxelStamp_;
+  std::vector<int> voxelEntry_;
+  std::vector<int> voxelRefs_;
+  std::vector<int> livePos_;
+  std::vector<double> sumX_;
+  std::vector<double> sumY_;
+  std::vector<double> sumZ_;
+  std::vector<int> count_;
+  std::vector<int> liveVoxels_;
+  std::vector<int> freeVoxels_;
+
+  int frameNum_;
+  int frameHead_;
+  int frameFill_;
+  uint32_t frameCount_;
+  std::vector<Frame> frames_;
+};
+
+#endif
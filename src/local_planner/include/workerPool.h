@@ -0,0 +1,104 @@
+#ifndef LOCAL_PLANNER_WORKER_POOL_H
+#define LOCAL_PLANNER_WORKER_POOL_H
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+// Persistent threads for short fork-join jobs issued from one thread. run() hands task 0 to the
+// calling thread and the others to the workers, and returns when all tasks are done.
+class WorkerPool
+{
+public:
+  WorkerPool() : generation_(0), taskNum_(0), pendingNum_(0), stop_(false) {}
+
+  ~WorkerPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    startCond_.notify_all();
+
+    for (size_t i = 0; i < threads_.size(); i++) {
+      threads_[i].join();
+    }
+  }
+
+  void start(int workerNum)
+  {
+    for (int i = 0; i < workerNum; i++) {
+      threads_.push_back(std::thread(&WorkerPool::workerLoop, this, i + 1));
+    }
+  }
+
+  int workerNum() const
+  {
+    return threads_.size();
+  }
+
+  // task ids beyond workerNum() + 1 are run by the calling thread after its own task
+  void run(int taskNum, const std::function<void(int)>& task)
+  {
+    if (taskNum <= 0) return;
+
+    int workerTaskNum = taskNum - 1;
+    if (workerTaskNum > int(threads_.size())) workerTaskNum = threads_.size();
+
+    if (workerTaskNum > 0) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      task_ = task;
+      taskNum_ = workerTaskNum + 1;
+      pendingNum_ = workerTaskNum;
+      generation_++;
+    }
+    if (workerTaskNum > 0) startCond_.notify_all();
+
+    task(0);
+    for (int i = workerTaskNum + 1; i < taskNum; i++) {
+      task(i);
+    }
+
+    if (workerTaskNum > 0) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      doneCond_.wait(lock, [this] { return pendingNum_ == 0; });
+    }
+  }
+
+private:
+  void workerLoop(int taskID)
+  {
+    unsigned long generation = 0;
+    while (true) {
+      std::function<void(int)> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        startCond_.wait(lock, [this, generation] { return stop_ || generation_ != generation; });
+        if (stop_) return;
+
+        generation = generation_;
+        if (taskID >= taskNum_) continue;
+        task = task_;
+      }
+
+      task(taskID);
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--pendingNum_ == 0) doneCond_.notify_one();
+    }
+  }
+
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable startCond_;
+  std::condition_variable doneCond_;
+  std::function<void(int)> task_;
+  unsigned long generation_;
+  int taskNum_;
+  int pendingNum_;
+  bool stop_;
+};
+
+#endif
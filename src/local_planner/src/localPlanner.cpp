@@ -2,7 +2,16 @@
 #include <time.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
 
 #include <message_filters/subscriber.h>
 #include <message_filters/synchronizer.h>
@@ -13,7 +22,11 @@
 #include <nav_msgs/Path.h>
 #include <nav_msgs/Odometry.h>
 #include <geometry_msgs/PointStamped.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
 #include <sensor_msgs/PointCloud2.h>
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/CameraInfo.h>
+#include <sensor_msgs/image_encodings.h>
 #include <sensor_msgs/Joy.h>
 
 #include <tf/transform_datatypes.h>
@@ -22,131 +35,99 @@
 #include <pcl_conversions/pcl_conversions.h>
 #include <pcl/point_cloud.h>
 #include <pcl/point_types.h>
-#include <pcl/filters/voxel_grid.h>
 #include <pcl/kdtree/kdtree_flann.h>
 
-#define PLOTPATHSET 1 // set to 0 to save processing and 1 to plot path set
+#include "plannerPipeline.h"
+#include "plannerRecording.h"
 
 using namespace std;
 
-const double PI = 3.1415926;
-
-// general parameters
-string pathFolder;
+// node parameters, the pipeline parameters are declared in plannerPipeline.h
 string stateEstimationTopic = "/state_estimation";
 string depthCloudTopic = "/rgbd_camera/depth/points";
-double depthCloudDelay = 0;
-double depthCamPitchOffset = 0;
-double depthCamXOffset = 0;
-double depthCamYOffset = 0;
-double depthCamZOffset = 0;
 bool trackingCamBackward = false;
 double trackingCamXOffset = 0;
 double trackingCamYOffset = 0;
 double trackingCamZOffset = 0;
 double trackingCamScale = 1.0;
-double scanVoxelSize = 0.1;
-const int laserCloudStackNum = 1;
-int laserCloudCount = 0;
-int pointPerPathThre = 2;
-double maxRange = 4.0;
-double maxElev = 5.0;
-bool keepSurrCloud = true;
-double keepHoriDis = 1.0;
-double keepVertDis = 0.5;
-double lowerBoundZ = -1.2;
-double upperBoundZ = 1.2;
-double pitchDiffLimit = 35.0;
-double pitchWeight = 0.03;
-double sensorMaxPitch = 25.0;
-double sensorMaxYaw = 40.0;
-double yawDiffLimit = 60.0;
-double yawWeight = 0.015;
-double pathScale = 0.5;
-double minPathScale = 0.25;
-double pathScaleStep = 0.125;
-bool pathScaleBySpeed = true;
-double stopDis = 0.5;
+bool directCloudInput = true;
+bool plotPathSet = true;
+bool profileStages = true;
+string profileTraceFile = "";
+string recordFile = "";
+bool useDepthImage = false;
+string depthImageTopic = "/rgbd_camera/depth/image_raw";
+string depthCamInfoTopic = "/rgbd_camera/depth/camera_info";
+int depthImageStride = 2;
+bool depthImageRadial = false;
+double depthImageRowTime = 0;
 bool shiftGoalAtStart = false;
-double goalX = 0;
-double goalY = 0;
-double goalZ = 1.0;
-
-// path parameters, set according to path files
-const int pathNum = 4375;
-const int groupNum = 25;
-float gridVoxelSize = 0.2;
-float searchRadiusHori = 1.2;
-float searchRadiusVert = 0.8;
-float gridVoxelOffsetX = 6.4;
-float gridVoxelOffsetY = 9.0;
-float gridVoxelOffsetZ = 3.3;
-const int gridVoxelNumX = 33;
-const int gridVoxelNumY = 91;
-const int gridVoxelNumZ = 34;
-const int gridVoxelNum = gridVoxelNumX * gridVoxelNumY * gridVoxelNumZ;
-
-float joyFwd = 0;
-float joyLeft = 0;
-float joyUp = 0;
-bool manualMode = true;
-bool autonomyMode = false;
-bool autoAdjustMode = false;
-int systemInitDelay = 5;
 int stateInitDelay = 100;
 
+// the goal shift at start is taken on the odometry thread and added to the goal on the
+// planner thread, which owns the goal, once goalShiftReady is set
+double goalShiftX = 0;
+double goalShiftY = 0;
+double goalShiftZ = 0;
+std::atomic<bool> goalShiftReady(false);
+
 pcl::PointCloud<pcl::PointXYZ>::Ptr laserCloud(new pcl::PointCloud<pcl::PointXYZ>());
-pcl::PointCloud<pcl::PointXYZ>::Ptr laserCloudCrop(new pcl::PointCloud<pcl::PointXYZ>());
-pcl::PointCloud<pcl::PointXYZ>::Ptr laserCloudDwz(new pcl::PointCloud<pcl::PointXYZ>());
-pcl::PointCloud<pcl::PointXYZ>::Ptr laserCloudStack[laserCloudStackNum];
-pcl::PointCloud<pcl::PointXYZ>::Ptr laserCloudKeep(new pcl::PointCloud<pcl::PointXYZ>());
-pcl::PointCloud<pcl::PointXYZ>::Ptr laserCloudKeepDwz(new pcl::PointCloud<pcl::PointXYZ>());
-pcl::PointCloud<pcl::PointXYZ>::Ptr plannerCloudStack(new pcl::PointCloud<pcl::PointXYZ>());
-pcl::PointCloud<pcl::PointXYZ>::Ptr plannerCloud(new pcl::PointCloud<pcl::PointXYZ>());
-pcl::PointCloud<pcl::PointXYZ>::Ptr startPaths[groupNum];
-#if PLOTPATHSET == 1
-pcl::PointCloud<pcl::PointXYZI>::Ptr paths[pathNum];
 pcl::PointCloud<pcl::PointXYZI>::Ptr freePaths(new pcl::PointCloud<pcl::PointXYZI>());
-#endif
-
-int pathList[pathNum] = {0};
-float endPitchPathList[pathNum] = {0};
-float endYawPathList[pathNum] = {0};
-float endZPathList[pathNum] = {0};
-int clearPathList[pathNum] = {0};
-float clearPathPerGroupScore[groupNum] = {0};
-std::vector<int> correspondences[gridVoxelNum];
-
-double laserTime = 0;
-bool newlaserCloud = false;
-
-int odomPointerFront = 0;
-int odomPointerLast = -1;
-const int odomQueLength = 400;
-double odomTime[odomQueLength] = {0};
-float odomRoll[odomQueLength] = {0};
-float odomPitch[odomQueLength] = {0};
-float odomYaw[odomQueLength] = {0};
-float odomX[odomQueLength] = {0};
-float odomY[odomQueLength] = {0};
-float odomZ[odomQueLength] = {0};
-
-float trackX = 0;
-float trackY = 0;
-float trackZ = 0;
-float trackRoll = 0;
-float trackPitch = 0;
-float trackYaw = 0;
-
-pcl::VoxelGrid<pcl::PointXYZ> downSizeFilter;
+
+// planner cloud and free paths handed to the visualization thread, filled only for the topics
+// with subscribers
+struct VisualizationFrame
+{
+  bool publishCloud;
+  bool publishFreePaths;
+  pcl::PointCloud<pcl::PointXYZ>::Ptr cloud;
+  double time;
+  std::vector<int> freePathList;
+  double pathScale;
+  float relativeGoalDis;
+  float relativeGoalX;
+};
+
+LatestFrameSlot<VisualizationFrame> visualizationSlot;
+std::mutex visualizationMutex;
+std::condition_variable visualizationCond;
+ros::Publisher pubFreePaths;
+ros::Publisher pubLaserCloud;
+
+bool cloudFieldsResolved = false;
+bool cloudFieldsDirect = false;
+uint32_t cloudPointStep = 0;
+bool cloudBigEndian = false;
+std::vector<sensor_msgs::PointField> cloudFields;
+int cloudFieldXOffset = 0;
+int cloudFieldYOffset = 0;
+int cloudFieldZOffset = 0;
+
+bool depthCamInfoInit = false;
+double depthCamFx = 0;
+double depthCamFy = 0;
+double depthCamCx = 0;
+double depthCamCy = 0;
+bool depthRayTableValid = false;
+int depthRayWidth = 0;
+int depthRayHeight = 0;
+int depthRayStep = 0;
+int depthRayPixelSize = 0;
+std::vector<int> depthRayRowStart;
+std::vector<int> depthRayRowV;
+std::vector<int> depthRayOffset;
+std::vector<float> depthRayX;
+std::vector<float> depthRayY;
+std::vector<float> depthRayZ;
 
 void stateEstimationHandler(const nav_msgs::Odometry::ConstPtr& odom)
 {
   if (stateInitDelay >= 0 && shiftGoalAtStart) {
     if (stateInitDelay == 0) {
-      goalX += trackingCamScale * odom->pose.pose.position.x;
-      goalY += trackingCamScale * odom->pose.pose.position.y;
-      goalZ += trackingCamScale * odom->pose.pose.position.z;
+      goalShiftX = trackingCamScale * odom->pose.pose.position.x;
+      goalShiftY = trackingCamScale * odom->pose.pose.position.y;
+      goalShiftZ = trackingCamScale * odom->pose.pose.position.z;
+      goalShiftReady.store(true, std::memory_order_release);
     }
     stateInitDelay--;
     return;
@@ -179,317 +160,265 @@ void stateEstimationHandler(const nav_msgs::Odometry::ConstPtr& odom)
   vehicleY -= pointX2 * sin(yaw) + pointY2 * cos(yaw) - trackingCamYOffset;
   vehicleZ -= pointZ2 - trackingCamZOffset;
 
-  odomPointerLast = (odomPointerLast + 1) % odomQueLength;
-
-  odomTime[odomPointerLast] = odom->header.stamp.toSec();
-  odomRoll[odomPointerLast] = roll;
-  odomPitch[odomPointerLast] = pitch;
-  odomYaw[odomPointerLast] = yaw;
-  odomX[odomPointerLast] = vehicleX;
-  odomY[odomPointerLast] = vehicleY;
-  odomZ[odomPointerLast] = vehicleZ;
+  addOdometry(odom->header.stamp.toSec(), roll, pitch, yaw, vehicleX, vehicleY, vehicleZ);
 }
 
-void laserCloudHandler(const sensor_msgs::PointCloud2ConstPtr& laserCloud2)
+// the layout is the point step, the byte order and the name, offset, datatype and count of
+// each field
+bool cloudFieldsChanged(const sensor_msgs::PointCloud2& cloud)
 {
-  if (systemInitDelay > 0) {
-    systemInitDelay--;
-    return;
-  }
-
-  if (odomPointerLast < 0) {
-    return;
-  }
-
-  //laserTime = laserCloud2->header.stamp.toSec() - depthCloudDelay;
-  laserTime = odomTime[odomPointerLast] - depthCloudDelay;
-
-  while (odomPointerFront != odomPointerLast) {
-    int odomPointerNext = (odomPointerFront + 1) % odomQueLength;
-    if (fabs(laserTime - odomTime[odomPointerFront]) < fabs(laserTime - odomTime[odomPointerNext])) {
-      break;
-    }
-    odomPointerFront = (odomPointerFront + 1) % odomQueLength;
+  if (!cloudFieldsResolved || cloud.point_step != cloudPointStep || bool(cloud.is_bigendian) != cloudBigEndian ||
+      cloud.fields.size() != cloudFields.size()) {
+    return true;
   }
 
-  float sinDepthCamPitch = sin(depthCamPitchOffset);
-  float cosDepthCamPitch = cos(depthCamPitchOffset);
-
-  float sinVehicleRoll = sin(odomRoll[odomPointerFront]);
-  float cosVehicleRoll = cos(odomRoll[odomPointerFront]);
-  float sinVehiclePitch = sin(odomPitch[odomPointerFront]);
-  float cosVehiclePitch = cos(odomPitch[odomPointerFront]);
-  float sinVehicleYaw = sin(odomYaw[odomPointerFront]);
-  float cosVehicleYaw = cos(odomYaw[odomPointerFront]);
-
-  float vehicleX = odomX[odomPointerFront];
-  float vehicleY = odomY[odomPointerFront];
-  float vehicleZ = odomZ[odomPointerFront];
-
-  laserCloud->clear();
-  pcl::fromROSMsg(*laserCloud2, *laserCloud);
-  int laserCloudSize = laserCloud->points.size();
-
-  laserCloudCrop->clear();
-  for (int i = 0; i < laserCloudSize; i++) {
-    if (laserCloud->points[i].z < maxRange) {
-      laserCloudCrop->push_back(laserCloud->points[i]);
+  int fieldNum = cloudFields.size();
+  for (int i = 0; i < fieldNum; i++) {
+    const sensor_msgs::PointField& field = cloud.fields[i];
+    const sensor_msgs::PointField& cachedField = cloudFields[i];
+    if (field.offset != cachedField.offset || field.datatype != cachedField.datatype ||
+        field.count != cachedField.count || field.name != cachedField.name) {
+      return true;
     }
   }
 
-  laserCloudDwz->clear();
-  downSizeFilter.setInputCloud(laserCloudCrop);
-  downSizeFilter.filter(*laserCloudDwz);
-
-  int laserCloudDwzSize = laserCloudDwz->points.size();
-  for (int i = 0; i < laserCloudDwzSize; i++) {
-      float pointX1 = laserCloudDwz->points[i].z;
-      float pointY1 = -laserCloudDwz->points[i].x;
-      float pointZ1 = -laserCloudDwz->points[i].y;
-
-      float pointX2 = pointX1 * cosDepthCamPitch + pointZ1 * sinDepthCamPitch + depthCamXOffset;
-      float pointY2 = pointY1 + depthCamYOffset;
-      float pointZ2 = -pointX1 * sinDepthCamPitch + pointZ1 * cosDepthCamPitch + depthCamZOffset;
-
-      float pointX3 = pointX2;
-      float pointY3 = pointY2 * cosVehicleRoll - pointZ2 * sinVehicleRoll;
-      float pointZ3 = pointY2 * sinVehicleRoll + pointZ2 * cosVehicleRoll;
-
-      float pointX4 = pointX3 * cosVehiclePitch + pointZ3 * sinVehiclePitch;
-      float pointY4 = pointY3;
-      float pointZ4 = -pointX3 * sinVehiclePitch + pointZ3 * cosVehiclePitch;
+  return false;
+}
 
-      laserCloudDwz->points[i].x = pointX4 * cosVehicleYaw - pointY4 * sinVehicleYaw + vehicleX;
-      laserCloudDwz->points[i].y = pointX4 * sinVehicleYaw + pointY4 * cosVehicleYaw + vehicleY;
-      laserCloudDwz->points[i].z = pointZ4 + vehicleZ;
+// field layout is resolved on the first message and again only if the layout changes
+bool checkCloudFields(const sensor_msgs::PointCloud2& cloud)
+{
+  if (!cloudFieldsChanged(cloud)) {
+    return cloudFieldsDirect;
   }
 
-  if (keepSurrCloud) {
-    for (int i = 0; i < laserCloudDwzSize; i++) {
-      float disX = laserCloudDwz->points[i].x - vehicleX;
-      float disY = laserCloudDwz->points[i].y - vehicleY;
-      float disZ = laserCloudDwz->points[i].z - vehicleZ;
-
-      if (sqrt(disX * disX + disY * disY) < keepHoriDis && fabs(disZ) < keepVertDis) {
-        laserCloudKeep->push_back(laserCloudDwz->points[i]);
-      }
+  int offsetX = -1, offsetY = -1, offsetZ = -1;
+  int fieldNum = cloud.fields.size();
+  for (int i = 0; i < fieldNum; i++) {
+    const sensor_msgs::PointField& field = cloud.fields[i];
+    if (field.datatype != sensor_msgs::PointField::FLOAT32 || field.count < 1 ||
+        field.offset + 4 > cloud.point_step) {
+      continue;
     }
 
-    *laserCloudDwz += *laserCloudKeepDwz;
-
-    laserCloudKeepDwz->clear();
-    downSizeFilter.setInputCloud(laserCloudKeep);
-    downSizeFilter.filter(*laserCloudKeepDwz);
-
-    laserCloudKeep->clear();
-    int laserCloudKeepDwzSize = laserCloudKeepDwz->points.size();
-    for (int i = 0; i < laserCloudKeepDwzSize; i++) {
-      float disX = laserCloudKeepDwz->points[i].x - vehicleX;
-      float disY = laserCloudKeepDwz->points[i].y - vehicleY;
-      float disZ = laserCloudKeepDwz->points[i].z - vehicleZ;
+    if (field.name == "x") offsetX = field.offset;
+    else if (field.name == "y") offsetY = field.offset;
+    else if (field.name == "z") offsetZ = field.offset;
+  }
 
-      if (sqrt(disX * disX + disY * disY) < keepHoriDis && fabs(disZ) < keepVertDis) {
-        laserCloudKeep->push_back(laserCloudKeepDwz->points[i]);
-      }
-    }
+  cloudFieldsResolved = true;
+  cloudPointStep = cloud.point_step;
+  cloudBigEndian = cloud.is_bigendian;
+  cloudFields = cloud.fields;
+  cloudFieldXOffset = offsetX;
+  cloudFieldYOffset = offsetY;
+  cloudFieldZOffset = offsetZ;
+  cloudFieldsDirect = offsetX >= 0 && offsetY >= 0 && offsetZ >= 0 && !cloud.is_bigendian;
+
+  if (!cloudFieldsDirect) {
+    printf ("\nDepth cloud has no little-endian float32 x/y/z fields, using fromROSMsg.\n");
   }
 
-  newlaserCloud = true;
+  return cloudFieldsDirect;
 }
 
-void trackPointHandler(const nav_msgs::Odometry::ConstPtr& odom)
+// crops straight from the message buffer, no intermediate PCL cloud
+void cropCloudMsg(const sensor_msgs::PointCloud2& cloud)
 {
-  double roll, pitch, yaw;
-  geometry_msgs::Quaternion geoQuat = odom->pose.pose.orientation;
-  tf::Matrix3x3(tf::Quaternion(geoQuat.x, geoQuat.y, geoQuat.z, geoQuat.w)).getRPY(roll, pitch, yaw);
+  int width = cloud.width;
+  int height = cloud.height;
+  if (width <= 0 || height <= 0 ||
+      uint64_t(cloud.row_step) * (height - 1) + uint64_t(cloud.point_step) * width > cloud.data.size()) {
+    return;
+  }
 
-  trackRoll = roll;
-  trackPitch = pitch;
-  trackYaw = yaw;
-  trackX = odom->pose.pose.position.x;
-  trackY = odom->pose.pose.position.y;
-  trackZ = odom->pose.pose.position.z;
+  float x, y, z;
+  for (int i = 0; i < height; i++) {
+    const uint8_t *pointPtr = &cloud.data[0] + uint64_t(cloud.row_step) * i;
+    for (int j = 0; j < width; j++) {
+      memcpy(&x, pointPtr + cloudFieldXOffset, 4);
+      memcpy(&y, pointPtr + cloudFieldYOffset, 4);
+      memcpy(&z, pointPtr + cloudFieldZOffset, 4);
+      addCropPoint(x, y, z);
+      pointPtr += cloudPointStep;
+    }
+  }
 }
 
-int readPlyHeader(FILE *filePtr)
+void laserCloudHandler(const sensor_msgs::PointCloud2ConstPtr& laserCloud2)
 {
-  char str[50];
-  int val, pointNum;
-  string strCur, strLast;
-  while (strCur != "end_header") {
-    val = fscanf(filePtr, "%s", str);
-    if (val != 1) {
-      printf ("\nError reading input files, exit.\n\n");
-      exit(1);
-    }
-
-    strLast = strCur;
-    strCur = string(str);
+  if (!startLaserFrame(laserCloud2->header.stamp.toSec())) {
+    return;
+  }
+  ScopedStageTimer totalTimer(stageProfiler, stageScanTotal);
 
-    if (strCur == "vertex" && strLast == "element") {
-      val = fscanf(filePtr, "%d", &pointNum);
-      if (val != 1) {
-        printf ("\nError reading input files, exit.\n\n");
-        exit(1);
-      }
+  ScopedStageTimer inputTimer(stageProfiler, stageScanInput);
+  if (directCloudInput && checkCloudFields(*laserCloud2)) {
+    cropCloudMsg(*laserCloud2);
+  } else {
+    laserCloud->clear();
+    pcl::fromROSMsg(*laserCloud2, *laserCloud);
+    int laserCloudSize = laserCloud->points.size();
+    for (int i = 0; i < laserCloudSize; i++) {
+      addCropPoint(laserCloud->points[i].x, laserCloud->points[i].y, laserCloud->points[i].z);
     }
   }
+  inputTimer.stop();
 
-  return pointNum;
+  finishLaserFrame(laserCloud2->header.stamp.toSec());
 }
 
-void readStartPaths()
+void depthCamInfoHandler(const sensor_msgs::CameraInfo::ConstPtr& camInfo)
 {
-  string fileName = pathFolder + "/startPaths.ply";
-
-  FILE *filePtr = fopen(fileName.c_str(), "r");
-  if (filePtr == NULL) {
-    printf ("\nCannot read input files, exit.\n\n");
-    exit(1);
+  if (camInfo->K[0] <= 0 || camInfo->K[4] <= 0) {
+    return;
   }
 
-  int pointNum = readPlyHeader(filePtr);
-
-  pcl::PointXYZ point;
-  int val1, val2, val3, val4, groupID;
-  for (int i = 0; i < pointNum; i++) {
-    val1 = fscanf(filePtr, "%f", &point.x);
-    val2 = fscanf(filePtr, "%f", &point.y);
-    val3 = fscanf(filePtr, "%f", &point.z);
-    val4 = fscanf(filePtr, "%d", &groupID);
-
-    if (val1 != 1 || val2 != 1 || val3 != 1 || val4 != 1) {
-      printf ("\nError reading input files, exit.\n\n");
-        exit(1);
-    }
-
-    if (groupID >= 0 && groupID < groupNum) {
-      startPaths[groupID]->push_back(point);
-    }
+  if (!depthCamInfoInit || camInfo->K[0] != depthCamFx || camInfo->K[4] != depthCamFy ||
+      camInfo->K[2] != depthCamCx || camInfo->K[5] != depthCamCy) {
+    depthCamFx = camInfo->K[0];
+    depthCamFy = camInfo->K[4];
+    depthCamCx = camInfo->K[2];
+    depthCamCy = camInfo->K[5];
+    depthRayTableValid = false;
+    depthCamInfoInit = true;
   }
-
-  fclose(filePtr);
 }
 
-#if PLOTPATHSET == 1
-void readPaths()
+// ray of every sampled pixel, scaled so that ray * depth gives the point in the camera frame
+void buildDepthRayTable(int width, int height, int step, int pixelSize)
 {
-  string fileName = pathFolder + "/paths.ply";
-
-  FILE *filePtr = fopen(fileName.c_str(), "r");
-  if (filePtr == NULL) {
-    printf ("\nCannot read input files, exit.\n\n");
-    exit(1);
-  }
-
-  int pointNum = readPlyHeader(filePtr);
-
-  pcl::PointXYZI point;
-  int pointSkipNum = 14;
-  int pointSkipCount = 0;
-  int val1, val2, val3, val4, val5, pathID;
-  for (int i = 0; i < pointNum; i++) {
-    val1 = fscanf(filePtr, "%f", &point.x);
-    val2 = fscanf(filePtr, "%f", &point.y);
-    val3 = fscanf(filePtr, "%f", &point.z);
-    val4 = fscanf(filePtr, "%d", &pathID);
-    val5 = fscanf(filePtr, "%f", &point.intensity);
-
-    if (val1 != 1 || val2 != 1 || val3 != 1 || val4 != 1 || val5 != 1) {
-      printf ("\nError reading input files, exit.\n\n");
-        exit(1);
-    }
-
-    if (pathID >= 0 && pathID < pathNum) {
-      pointSkipCount++;
-      if (pointSkipCount > pointSkipNum) {
-        paths[pathID]->push_back(point);
-        pointSkipCount = 0;
+  depthRayRowStart.clear();
+  depthRayRowV.clear();
+  depthRayOffset.clear();
+  depthRayX.clear();
+  depthRayY.clear();
+  depthRayZ.clear();
+
+  for (int v = depthImageStride / 2; v < height; v += depthImageStride) {
+    depthRayRowStart.push_back(depthRayOffset.size());
+    depthRayRowV.push_back(v);
+    for (int u = depthImageStride / 2; u < width; u += depthImageStride) {
+      float rayX = (u - depthCamCx) / depthCamFx;
+      float rayY = (v - depthCamCy) / depthCamFy;
+      float rayZ = 1.0;
+
+      if (depthImageRadial) {
+        float rayNorm = sqrt(rayX * rayX + rayY * rayY + 1.0);
+        rayX /= rayNorm;
+        rayY /= rayNorm;
+        rayZ /= rayNorm;
       }
+
+      depthRayOffset.push_back(v * step + u * pixelSize);
+      depthRayX.push_back(rayX);
+      depthRayY.push_back(rayY);
+      depthRayZ.push_back(rayZ);
     }
   }
 
-  fclose(filePtr);
+  depthRayRowStart.push_back(depthRayOffset.size());
+
+  depthRayWidth = width;
+  depthRayHeight = height;
+  depthRayStep = step;
+  depthRayPixelSize = pixelSize;
+  depthRayTableValid = true;
 }
-#endif
 
-void readPathList()
+inline void addDepthPoint(float x, float y, float z, const float *deskewTransform)
 {
-  string fileName = pathFolder + "/pathList.ply";
-
-  FILE *filePtr = fopen(fileName.c_str(), "r");
-  if (filePtr == NULL) {
-    printf ("\nCannot read input files, exit.\n\n");
-    exit(1);
+  if (deskewTransform != NULL) {
+    addCropPoint(deskewTransform[0] * x + deskewTransform[1] * y + deskewTransform[2] * z + deskewTransform[3],
+                 deskewTransform[4] * x + deskewTransform[5] * y + deskewTransform[6] * z + deskewTransform[7],
+                 deskewTransform[8] * x + deskewTransform[9] * y + deskewTransform[10] * z + deskewTransform[11]);
+  } else {
+    addCropPoint(x, y, z);
   }
+}
 
-  if (pathNum != readPlyHeader(filePtr)) {
-    printf ("\nIncorrect path number, exit.\n\n");
-    exit(1);
+void depthImageHandler(const sensor_msgs::Image::ConstPtr& depthImage)
+{
+  if (!depthCamInfoInit) {
+    return;
   }
 
-  int val1, val2, val3, val4, val5, pathID, groupID;
-  float endX, endY, endZ;
-  for (int i = 0; i < pathNum; i++) {
-    val1 = fscanf(filePtr, "%f", &endX);
-    val2 = fscanf(filePtr, "%f", &endY);
-    val3 = fscanf(filePtr, "%f", &endZ);
-    val4 = fscanf(filePtr, "%d", &pathID);
-    val5 = fscanf(filePtr, "%d", &groupID);
-
-    if (val1 != 1 || val2 != 1 || val3 != 1 || val4 != 1 || val5 != 1) {
-      printf ("\nError reading input files, exit.\n\n");
-        exit(1);
-    }
-
-    if (pathID >= 0 && pathID < pathNum && groupID >= 0 && groupID < groupNum) {
-      pathList[pathID] = groupID;
-      endPitchPathList[pathID] = -atan2(endZ, sqrt(endX * endX + endY * endY)) * 180.0 / PI;
-      endYawPathList[pathID] = atan2(endY, endX) * 180.0 / PI;
-      endZPathList[pathID] = endZ;
-    }
+  bool floatDepth = depthImage->encoding == sensor_msgs::image_encodings::TYPE_32FC1;
+  bool shortDepth = depthImage->encoding == sensor_msgs::image_encodings::TYPE_16UC1 ||
+                    depthImage->encoding == sensor_msgs::image_encodings::MONO16;
+  if ((!floatDepth && !shortDepth) || depthImage->is_bigendian) {
+    return;
   }
 
-  fclose(filePtr);
-}
+  int width = depthImage->width;
+  int height = depthImage->height;
+  int step = depthImage->step;
+  int pixelSize = floatDepth ? 4 : 2;
+  if (width <= 0 || height <= 0 || step < width * pixelSize ||
+      uint64_t(step) * height > depthImage->data.size()) {
+    return;
+  }
 
-void readCorrespondences()
-{
-  string fileName = pathFolder + "/correspondences.txt";
+  if (!startLaserFrame(depthImage->header.stamp.toSec())) {
+    return;
+  }
+  ScopedStageTimer totalTimer(stageProfiler, stageScanTotal);
 
-  FILE *filePtr = fopen(fileName.c_str(), "rb");
-  if (filePtr == NULL) {
-    printf ("\nCannot read input files, exit.\n\n");
-    exit(1);
+  ScopedStageTimer inputTimer(stageProfiler, stageScanInput);
+  if (!depthRayTableValid || width != depthRayWidth || height != depthRayHeight ||
+      step != depthRayStep || pixelSize != depthRayPixelSize) {
+    buildDepthRayTable(width, height, step, pixelSize);
   }
 
-  short pathID;
-  int val1, gridVoxelID;
-  for (int i = 0; i < gridVoxelNum; i++) {
-    val1 = fread(&gridVoxelID, 4, 1, filePtr);
-    if (val1 != 1) {
-      printf ("\nError reading input files, exit.\n\n");
-        exit(1);
+  // with depthImageRowTime set, each row is moved to the camera pose of the middle row, which
+  // the image stamp refers to, compensating the rolling shutter readout
+  const uint8_t *imageData = &depthImage->data[0];
+  int rowNum = depthRayRowV.size();
+  float deskewTransform[12];
+  for (int row = 0; row < rowNum; row++) {
+    const float *rowTransform = NULL;
+    if (depthImageRowTime > 0 &&
+        getScanDeskewTransform((depthRayRowV[row] - 0.5 * (height - 1)) * depthImageRowTime, deskewTransform)) {
+      rowTransform = deskewTransform;
     }
 
-    while (1) {
-      val1 = fread(&pathID, 2, 1, filePtr);
-      if (val1 != 1) {
-        printf ("\nError reading input files, exit.\n\n");
-          exit(1);
+    int rayEnd = depthRayRowStart[row + 1];
+    if (floatDepth) {
+      float depth;
+      for (int i = depthRayRowStart[row]; i < rayEnd; i++) {
+        memcpy(&depth, imageData + depthRayOffset[i], 4);
+        if (depth > 0) {
+          addDepthPoint(depthRayX[i] * depth, depthRayY[i] * depth, depthRayZ[i] * depth, rowTransform);
+        }
       }
-
-      if (pathID != -1) {
-        if (gridVoxelID >= 0 && gridVoxelID < gridVoxelNum && pathID >= 0 && pathID < pathNum) {
-          correspondences[gridVoxelID].push_back(pathID);
+    } else {
+      uint16_t depthMm;
+      for (int i = depthRayRowStart[row]; i < rayEnd; i++) {
+        memcpy(&depthMm, imageData + depthRayOffset[i], 2);
+        if (depthMm > 0) {
+          float depth = 0.001 * depthMm;
+          addDepthPoint(depthRayX[i] * depth, depthRayY[i] * depth, depthRayZ[i] * depth, rowTransform);
         }
-      } else {
-        break;
       }
     }
   }
+  inputTimer.stop();
 
-  fclose(filePtr);
+  finishLaserFrame(depthImage->header.stamp.toSec());
+}
+
+void trackPointHandler(const nav_msgs::Odometry::ConstPtr& odom)
+{
+  double roll, pitch, yaw;
+  geometry_msgs::Quaternion geoQuat = odom->pose.pose.orientation;
+  tf::Matrix3x3(tf::Quaternion(geoQuat.x, geoQuat.y, geoQuat.z, geoQuat.w)).getRPY(roll, pitch, yaw);
+
+  trackRoll = roll;
+  trackPitch = pitch;
+  trackYaw = yaw;
+  trackX = odom->pose.pose.position.x;
+  trackY = odom->pose.pose.position.y;
+  trackZ = odom->pose.pose.position.z;
 }
 
 void joystickHandler(const sensor_msgs::Joy::ConstPtr& joy)
@@ -517,8 +446,8 @@ void joystickHandler(const sensor_msgs::Joy::ConstPtr& joy)
   }
 
   if (joy->buttons[5] > 0.5) {
-    laserCloudKeep->clear();
-    laserCloudKeepDwz->clear();
+    clearSurrCloudRequest = true;
+    plannerRecorder.write(recordClearSurrCloud, NULL, 0);
   }
 }
 
@@ -548,8 +477,142 @@ void autoModeHandler(const std_msgs::Float32::ConstPtr& autoMode)
 
 void clearSurrCloudHandler(const std_msgs::Empty::ConstPtr& clear)
 {
-  laserCloudKeep->clear();
-  laserCloudKeepDwz->clear();
+  clearSurrCloudRequest = true;
+  plannerRecorder.write(recordClearSurrCloud, NULL, 0);
+}
+
+void writePlanRecord()
+{
+  PlanRecord record;
+  record.scanStamp = plannerCloudStamp;
+  record.goalX = goalX;
+  record.goalY = goalY;
+  record.goalZ = goalZ;
+  record.trackX = trackX;
+  record.trackY = trackY;
+  record.trackZ = trackZ;
+  record.trackRoll = trackRoll;
+  record.trackPitch = trackPitch;
+  record.trackYaw = trackYaw;
+  record.joyFwd = joyFwd;
+  record.joyLeft = joyLeft;
+  record.joyUp = joyUp;
+  record.manualMode = manualMode;
+  record.autonomyMode = autonomyMode;
+  record.autoAdjustMode = autoAdjustMode;
+  record.reserved = 0;
+  plannerRecorder.write(recordPlan, &record, sizeof(record));
+}
+
+bool takeRecordedPlannerFrame()
+{
+  if (!plannerRecorder.isOpen()) {
+    return takePlannerFrame();
+  }
+
+  std::lock_guard<std::mutex> lock(plannerRecordMutex);
+  if (!takePlannerFrame()) {
+    return false;
+  }
+  writePlanRecord();
+  return true;
+}
+
+// publishes the stage timings since the last call, stages without samples are left out
+void publishStageDiagnostics(ros::Publisher& pubDiagnostics)
+{
+  diagnostic_msgs::DiagnosticArray diagnostics;
+  diagnostics.header.stamp = ros::Time::now();
+
+  StageStats stats;
+  for (int i = 0; i < plannerStageNum; i++) {
+    stageProfiler.snapshot(i, stats);
+    if (stats.count == 0) continue;
+
+    char str[100];
+    snprintf(str, sizeof(str), "p50 %.3f ms, p99 %.3f ms, max %.3f ms", stats.p50Ms, stats.p99Ms, stats.maxMs);
+
+    diagnostic_msgs::DiagnosticStatus status;
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.name = "localPlanner: " + stageProfiler.stageName(i);
+    status.hardware_id = "local_planner";
+    status.message = str;
+    addDiagnosticValue(status, "count", stats.count);
+    addDiagnosticValue(status, "mean_ms", stats.meanMs);
+    addDiagnosticValue(status, "p50_ms", stats.p50Ms);
+    addDiagnosticValue(status, "p99_ms", stats.p99Ms);
+    addDiagnosticValue(status, "max_ms", stats.maxMs);
+    diagnostics.status.push_back(status);
+  }
+
+  pubDiagnostics.publish(diagnostics);
+  stageProfiler.flushTrace();
+}
+
+// builds and publishes the visualization messages at idle priority so that serializing them
+// never delays planning, paths.ply is read here when /free_paths is first subscribed
+void visualizationThread()
+{
+  sched_param schedParam;
+  schedParam.sched_priority = 0;
+  pthread_setschedparam(pthread_self(), SCHED_IDLE, &schedParam);
+
+  sensor_msgs::PointCloud2 plannerCloud2, freePaths2;
+  while (ros::ok()) {
+    {
+      std::unique_lock<std::mutex> lock(visualizationMutex);
+      visualizationCond.wait_for(lock, std::chrono::milliseconds(100),
+                                 [] { return visualizationSlot.hasNewFrame(); });
+    }
+
+    if (!visualizationSlot.update()) {
+      continue;
+    }
+    VisualizationFrame& frame = visualizationSlot.readBuffer();
+    ScopedStageTimer visualizationTimer(stageProfiler, stageVisualization);
+
+    if (frame.publishCloud) {
+      pcl::toROSMsg(*frame.cloud, plannerCloud2);
+      plannerCloud2.header.stamp = ros::Time().fromSec(frame.time);
+      plannerCloud2.header.frame_id = "map";
+      pubLaserCloud.publish(plannerCloud2);
+    }
+
+    if (frame.publishFreePaths) {
+      if (!pathPointsLoaded && !pathPointsFailed) {
+        printf ("\nReading paths for visualization.\n");
+        pathPointsLoaded = readPaths();
+        pathPointsFailed = !pathPointsLoaded;
+      }
+
+      freePaths->clear();
+      pcl::PointXYZI point;
+      int freePathNum = pathPointsLoaded ? frame.freePathList.size() : 0;
+      for (int i = 0; i < freePathNum; i++) {
+        int pathID = frame.freePathList[i];
+        int freePathEnd = pathPointStart[pathID + 1];
+        for (int j = pathPointStart[pathID]; j < freePathEnd; j++) {
+          point.x = pathPointX[j];
+          point.y = pathPointY[j];
+          point.z = pathPointZ[j];
+          point.intensity = pathPointIntensity[j];
+          float dis = sqrt(point.x * point.x + point.y * point.y);
+          if (dis <= (frame.relativeGoalDis + stopDis) / frame.pathScale || frame.relativeGoalX < 0) {
+            point.x *= frame.pathScale;
+            point.y *= frame.pathScale;
+            point.z *= frame.pathScale;
+
+            freePaths->push_back(point);
+          }
+        }
+      }
+
+      pcl::toROSMsg(*freePaths, freePaths2);
+      freePaths2.header.stamp = ros::Time().fromSec(frame.time);
+      freePaths2.header.frame_id = "track_point";
+      pubFreePaths.publish(freePaths2);
+    }
+  }
 }
 
 int main(int argc, char** argv)
@@ -559,10 +622,12 @@ int main(int argc, char** argv)
   ros::NodeHandle nhPrivate = ros::NodeHandle("~");
 
   nhPrivate.getParam("pathFolder", pathFolder);
+  nhPrivate.getParam("usePathLibrary", usePathLibrary);
   nhPrivate.getParam("stateEstimationTopic", stateEstimationTopic);
   nhPrivate.getParam("autonomyMode", autonomyMode);
   nhPrivate.getParam("depthCloudTopic", depthCloudTopic);
   nhPrivate.getParam("depthCloudDelay", depthCloudDelay);
+  nhPrivate.getParam("useCloudStamp", useCloudStamp);
   nhPrivate.getParam("depthCamPitchOffset", depthCamPitchOffset);
   nhPrivate.getParam("depthCamXOffset", depthCamXOffset);
   nhPrivate.getParam("depthCamYOffset", depthCamYOffset);
@@ -573,12 +638,35 @@ int main(int argc, char** argv)
   nhPrivate.getParam("trackingCamZOffset", trackingCamZOffset);
   nhPrivate.getParam("trackingCamScale", trackingCamScale);
   nhPrivate.getParam("scanVoxelSize", scanVoxelSize);
+  nhPrivate.getParam("laserCloudStackNum", laserCloudStackNum);
+  nhPrivate.getParam("useVoxelHashFilter", useVoxelHashFilter);
+  nhPrivate.getParam("temporalFilter", temporalFilter);
+  nhPrivate.getParam("temporalFilterFrames", temporalFilterFrames);
+  nhPrivate.getParam("temporalFilterMinHits", temporalFilterMinHits);
+  nhPrivate.getParam("temporalFilterPassDis", temporalFilterPassDis);
+  nhPrivate.getParam("directCloudInput", directCloudInput);
+  nhPrivate.getParam("threadedIngest", threadedIngest);
+  nhPrivate.getParam("eventDrivenPlanning", eventDrivenPlanning);
+  nhPrivate.getParam("parallelScaleSearch", parallelScaleSearch);
+  nhPrivate.getParam("plotPathSet", plotPathSet);
+  nhPrivate.getParam("profileStages", profileStages);
+  nhPrivate.getParam("profileTraceFile", profileTraceFile);
+  nhPrivate.getParam("recordFile", recordFile);
+  nhPrivate.getParam("useDepthImage", useDepthImage);
+  nhPrivate.getParam("depthImageTopic", depthImageTopic);
+  nhPrivate.getParam("depthCamInfoTopic", depthCamInfoTopic);
+  nhPrivate.getParam("depthImageStride", depthImageStride);
+  nhPrivate.getParam("depthImageRadial", depthImageRadial);
+  nhPrivate.getParam("depthImageRowTime", depthImageRowTime);
   nhPrivate.getParam("pointPerPathThre", pointPerPathThre);
+  nhPrivate.getParam("bitsetVoting", bitsetVoting);
   nhPrivate.getParam("maxRange", maxRange);
   nhPrivate.getParam("maxElev", maxElev);
   nhPrivate.getParam("keepSurrCloud", keepSurrCloud);
   nhPrivate.getParam("keepHoriDis", keepHoriDis);
   nhPrivate.getParam("keepVertDis", keepVertDis);
+  nhPrivate.getParam("keepDecayFrames", keepDecayFrames);
+  nhPrivate.getParam("keepMinHits", keepMinHits);
   nhPrivate.getParam("lowerBoundZ", lowerBoundZ);
   nhPrivate.getParam("upperBoundZ", upperBoundZ);
   nhPrivate.getParam("pitchDiffLimit", pitchDiffLimit);
@@ -591,6 +679,15 @@ int main(int argc, char** argv)
   nhPrivate.getParam("minPathScale", minPathScale);
   nhPrivate.getParam("pathScaleStep", pathScaleStep);
   nhPrivate.getParam("pathScaleBySpeed", pathScaleBySpeed);
+  nhPrivate.getParam("gridVoxelSize", gridVoxelSize);
+  nhPrivate.getParam("searchRadiusHori", searchRadiusHori);
+  nhPrivate.getParam("searchRadiusVert", searchRadiusVert);
+  nhPrivate.getParam("gridVoxelOffsetX", gridVoxelOffsetX);
+  nhPrivate.getParam("gridVoxelOffsetY", gridVoxelOffsetY);
+  nhPrivate.getParam("gridVoxelOffsetZ", gridVoxelOffsetZ);
+  nhPrivate.getParam("gridVoxelNumX", gridVoxelNumX);
+  nhPrivate.getParam("gridVoxelNumY", gridVoxelNumY);
+  nhPrivate.getParam("gridVoxelNumZ", gridVoxelNumZ);
   nhPrivate.getParam("stopDis", stopDis);
   nhPrivate.getParam("shiftGoalAtStart", shiftGoalAtStart);
   nhPrivate.getParam("goalX", goalX);
@@ -603,9 +700,25 @@ int main(int argc, char** argv)
     joyFwd = 1.0;
   }
 
-  ros::Subscriber subStateEstimation = nh.subscribe<nav_msgs::Odometry> (stateEstimationTopic, 5, stateEstimationHandler);
+  // with threadedIngest, odometry and scan preprocessing are served by their own spinner threads
+  ros::CallbackQueue odomQueue, cloudQueue;
+  ros::NodeHandle nhOdom, nhCloud;
+  if (threadedIngest) {
+    nhOdom.setCallbackQueue(&odomQueue);
+    nhCloud.setCallbackQueue(&cloudQueue);
+  }
+
+  ros::Subscriber subStateEstimation = nhOdom.subscribe<nav_msgs::Odometry> (stateEstimationTopic, 5, stateEstimationHandler);
+
+  if (depthImageStride < 1) depthImageStride = 1;
 
-  ros::Subscriber subLaserCloud = nh.subscribe<sensor_msgs::PointCloud2> (depthCloudTopic, 5, laserCloudHandler);
+  ros::Subscriber subLaserCloud, subDepthImage, subDepthCamInfo;
+  if (useDepthImage) {
+    subDepthImage = nhCloud.subscribe<sensor_msgs::Image> (depthImageTopic, 5, depthImageHandler);
+    subDepthCamInfo = nhCloud.subscribe<sensor_msgs::CameraInfo> (depthCamInfoTopic, 5, depthCamInfoHandler);
+  } else {
+    subLaserCloud = nhCloud.subscribe<sensor_msgs::PointCloud2> (depthCloudTopic, 5, laserCloudHandler);
+  }
 
   ros::Subscriber subTrackPoint = nh.subscribe<nav_msgs::Odometry> ("/track_point_odom", 5, trackPointHandler);
 
@@ -618,257 +731,135 @@ int main(int argc, char** argv)
   ros::Subscriber subClearSurrCloud = nh.subscribe<std_msgs::Empty> ("/clear_surr_cloud", 5, clearSurrCloudHandler);
 
   ros::Publisher pubPath = nh.advertise<nav_msgs::Path> ("/path", 5);
-  nav_msgs::Path path;
 
-  #if PLOTPATHSET == 1
-  ros::Publisher pubFreePaths = nh.advertise<sensor_msgs::PointCloud2> ("/free_paths", 2);
+  ros::Publisher pubPlanningLatency = nh.advertise<std_msgs::Float32> ("/planning_latency", 5);
 
-  ros::Publisher pubLaserCloud = nh.advertise<sensor_msgs::PointCloud2> ("/collision_avoidance_cloud", 2);
-  #endif
+  ros::Publisher pubDiagnostics = nh.advertise<diagnostic_msgs::DiagnosticArray> ("/diagnostics", 5);
+  std_msgs::Float32 planningLatency;
+  nav_msgs::Path path;
 
-  printf ("\nReading path files.\n");
+  if (plotPathSet) {
+    pubFreePaths = nh.advertise<sensor_msgs::PointCloud2> ("/free_paths", 2);
 
-  for (int i = 0; i < laserCloudStackNum; i++) {
-    laserCloudStack[i].reset(new pcl::PointCloud<pcl::PointXYZ>());
+    pubLaserCloud = nh.advertise<sensor_msgs::PointCloud2> ("/collision_avoidance_cloud", 2);
   }
-  for (int i = 0; i < groupNum; i++) {
-    startPaths[i].reset(new pcl::PointCloud<pcl::PointXYZ>());
+
+  initPlannerPipeline();
+
+  for (int i = 0; i < 3; i++) {
+    visualizationSlot.buffer(i).cloud.reset(new pcl::PointCloud<pcl::PointXYZ>());
   }
-  #if PLOTPATHSET == 1
-  for (int i = 0; i < pathNum; i++) {
-    paths[i].reset(new pcl::PointCloud<pcl::PointXYZI>());
+
+  if (profileStages || profileTraceFile != "") {
+    stageProfiler.init(plannerStageNames, plannerStageNum);
+    if (profileTraceFile != "" && !stageProfiler.openTrace(profileTraceFile)) {
+      printf ("\nCannot write trace file %s.\n", profileTraceFile.c_str());
+    }
   }
-  #endif
-  for (int i = 0; i < gridVoxelNum; i++) {
-    correspondences[i].resize(0);
+  int64_t diagnosticsTimeNs = StageProfiler::nowNs();
+
+  if (recordFile != "") {
+    if (plannerRecorder.open(recordFile)) {
+      string params;
+      for (int i = 0; i < plannerParamNum; i++) {
+        params += string(plannerParams[i].name) + "=" + getPlannerParam(plannerParams[i]) + "\n";
+      }
+      plannerRecorder.write(recordParams, params.data(), params.size());
+      recordScanInput = true;
+    } else {
+      printf ("\nCannot write recording file %s.\n", recordFile.c_str());
+    }
   }
 
-  downSizeFilter.setLeafSize(scanVoxelSize, scanVoxelSize, scanVoxelSize);
+  printf ("\nInitialization complete.\n\n");
 
-  readStartPaths();
-  #if PLOTPATHSET == 1
-  readPaths();
-  #endif
-  readPathList();
-  readCorrespondences();
+  std::thread visualizer;
+  if (plotPathSet) {
+    visualizer = std::thread(visualizationThread);
+  }
 
-  printf ("\nInitialization complete.\n\n");
+  ros::AsyncSpinner odomSpinner(1, &odomQueue);
+  ros::AsyncSpinner cloudSpinner(1, &cloudQueue);
+  if (threadedIngest) {
+    odomSpinner.start();
+    cloudSpinner.start();
+  }
 
   ros::Rate rate(100);
   bool status = ros::ok();
   while (status) {
     ros::spinOnce();
 
-    if (newlaserCloud) {
-      newlaserCloud = false;
-
-      laserCloudStack[laserCloudCount]->clear();
-      *laserCloudStack[laserCloudCount] = *laserCloudDwz;
-      laserCloudCount = (laserCloudCount + 1) % laserCloudStackNum;
-
-      plannerCloudStack->clear();
-      for (int i = 0; i < laserCloudStackNum; i++) {
-        *plannerCloudStack += *laserCloudStack[i];
-      }
-
-      plannerCloud->clear();
-      downSizeFilter.setInputCloud(plannerCloudStack);
-      downSizeFilter.filter(*plannerCloud);
+    if (goalShiftReady.load(std::memory_order_acquire)) {
+      goalX += goalShiftX;
+      goalY += goalShiftY;
+      goalZ += goalShiftZ;
+      goalShiftReady = false;
+    }
 
-      #if PLOTPATHSET == 1
-      sensor_msgs::PointCloud2 plannerCloud2;
-      pcl::toROSMsg(*plannerCloud, plannerCloud2);
-      plannerCloud2.header.stamp = ros::Time().fromSec(laserTime);
-      plannerCloud2.header.frame_id = "map";
-      pubLaserCloud.publish(plannerCloud2);
-      #endif
-
-      float sinTrackPitch = sin(trackPitch);
-      float cosTrackPitch = cos(trackPitch);
-      float sinTrackYaw = sin(trackYaw);
-      float cosTrackYaw = cos(trackYaw);
-
-      int plannerCloudSize = plannerCloud->points.size();
-      for (int i = 0; i < plannerCloudSize; i++) {
-        float pointX1 = plannerCloud->points[i].x - trackX;
-        float pointY1 = plannerCloud->points[i].y - trackY;
-        float pointZ1 = plannerCloud->points[i].z - trackZ;
-
-        float pointX2 = pointX1 * cosTrackYaw + pointY1 * sinTrackYaw;
-        float pointY2 = -pointX1 * sinTrackYaw + pointY1 * cosTrackYaw;
-        float pointZ2 = pointZ1;
-
-        plannerCloud->points[i].x = pointX2 * cosTrackPitch - pointZ2 * sinTrackPitch;
-        plannerCloud->points[i].y = pointY2;
-        plannerCloud->points[i].z = pointX2 * sinTrackPitch + pointZ2 * cosTrackPitch;
+    if (takeRecordedPlannerFrame()) {
+      ScopedStageTimer planningTimer(stageProfiler, stagePlanningTotal);
+
+      VisualizationFrame *visualizationFrame = NULL;
+      if (plotPathSet && (pubLaserCloud.getNumSubscribers() > 0 || pubFreePaths.getNumSubscribers() > 0)) {
+        visualizationFrame = &visualizationSlot.writeBuffer();
+        visualizationFrame->time = plannerCloudTime;
+        visualizationFrame->publishCloud = pubLaserCloud.getNumSubscribers() > 0;
+        visualizationFrame->publishFreePaths = pubFreePaths.getNumSubscribers() > 0;
+        visualizationFrame->freePathList.clear();
+        if (visualizationFrame->publishCloud) {
+          getPlannerCloudWorld(*visualizationFrame->cloud);
+        }
       }
 
+      int selectedScaleID = planPaths();
       bool pathPublished = false;
-      float pathScaleOri = pathScale;
-      if (manualMode || (autonomyMode && autoAdjustMode)) pathScale = minPathScale;
-      else if (pathScaleBySpeed) pathScale *= joyFwd;
-      if (pathScale < minPathScale) pathScale = minPathScale;
-
-      while (pathScale >= minPathScale) {
-        for (int i = 0; i < pathNum; i++) {
-          clearPathList[i] = 0;
-        }
-        for (int i = 0; i < groupNum; i++) {
-          clearPathPerGroupScore[i] = 0;
-        }
+      double pathPublishTime = 0;
 
-        float goalX1 = (goalX - trackX) * cosTrackYaw + (goalY - trackY) * sinTrackYaw;
-        float goalY1 = -(goalX - trackX) * sinTrackYaw + (goalY - trackY) * cosTrackYaw;
-        float goalZ1 = goalZ - trackZ;
-
-        float relativeGoalX = (goalX1 * cosTrackPitch - goalZ1 * sinTrackPitch);
-        float relativeGoalY = goalY1;
-        float relativeGoalZ = (goalX1 * sinTrackPitch + goalZ1 * cosTrackPitch);
-
-        float relativeGoalDis = sqrt(relativeGoalX * relativeGoalX + relativeGoalY * relativeGoalY);
-        float relativeGoalPitch = -atan2(relativeGoalZ, sqrt(relativeGoalX * relativeGoalX 
-                              + relativeGoalY * relativeGoalY)) * 180.0 / PI;
-        float relativeGoalYaw = atan2(relativeGoalY, relativeGoalX) * 180.0 / PI;
-
-        if (relativeGoalPitch < -pitchDiffLimit) relativeGoalPitch = -pitchDiffLimit;
-        else if (relativeGoalPitch > pitchDiffLimit) relativeGoalPitch = pitchDiffLimit;
-        if (relativeGoalYaw < -yawDiffLimit) relativeGoalYaw = -yawDiffLimit;
-        else if (relativeGoalYaw > yawDiffLimit) relativeGoalYaw = yawDiffLimit;
-
-        if (manualMode || (autonomyMode && autoAdjustMode)) {
-          relativeGoalDis = 1000.0;
-          relativeGoalPitch = 0;
-          relativeGoalYaw = 0;
-        } else if (!autonomyMode) {
-          relativeGoalDis = 1000.0;
-          relativeGoalPitch = -joyUp;
-          relativeGoalYaw = joyLeft;
-        }
-
-        for (int i = 0; i < plannerCloudSize; i++) {
-          float x = plannerCloud->points[i].x / pathScale;
-          float y = plannerCloud->points[i].y / pathScale;
-          float z = plannerCloud->points[i].z / pathScale;
-          float dis = sqrt(x * x + y * y);
-
-          if (x > 0 && (dis <= (relativeGoalDis + stopDis) / pathScale || relativeGoalX < 0) && 
-              z > lowerBoundZ / pathScale && z < upperBoundZ / pathScale) {
-            float scaleY = x / gridVoxelOffsetX + searchRadiusHori / gridVoxelOffsetY
-                         * (gridVoxelOffsetX - x) / gridVoxelOffsetX;
-            float scaleZ = x / gridVoxelOffsetX + searchRadiusVert / gridVoxelOffsetZ
-                         * (gridVoxelOffsetX - x) / gridVoxelOffsetX;
-
-            int indX = int((gridVoxelOffsetX + gridVoxelSize / 2 - x) / gridVoxelSize);
-            int indY = int((gridVoxelOffsetY + gridVoxelSize / 2 - y / scaleY) / gridVoxelSize);
-            int indZ = int((gridVoxelOffsetZ + gridVoxelSize / 2 - z / scaleZ) / gridVoxelSize);
-            if (indX >= 0 && indX < gridVoxelNumX && indY >= 0 && indY < gridVoxelNumY && 
-                indZ >= 0 && indZ < gridVoxelNumZ) {
-              int ind = gridVoxelNumY * gridVoxelNumZ * indX + gridVoxelNumZ * indY + indZ;
-              int blockedPathByVoxelNum = correspondences[ind].size();
-              for (int j = 0; j < blockedPathByVoxelNum; j++) {
-                clearPathList[correspondences[ind][j]]++;
-              }
-            }
-          }
-        }
-
-        for (int i = 0; i < pathNum; i++) {
-          float vehiclePitch = odomPitch[odomPointerFront];
-          float vehicleYaw = odomYaw[odomPointerFront];
-          float pitch = endPitchPathList[i];
-          float yaw = trackYaw * 180.0 / PI + endYawPathList[i];
-          float pitchDiff = fabs(pitch + trackPitch * 180.0 / PI - vehiclePitch * 180.0 / PI - depthCamPitchOffset * 180.0 / PI);
-          float yawDiff = fabs(yaw - vehicleYaw * 180.0 / PI);
-          if (yawDiff > 180.0) yawDiff = 360.0 - yawDiff;
-          float elev = trackZ + endZPathList[i];
-          if (yawDiff > sensorMaxYaw || pitchDiff > sensorMaxPitch || elev > maxElev) {
-            clearPathList[i] += pointPerPathThre;
-            continue;
-          }
-          if (clearPathList[i] < pointPerPathThre) {
-            float pitchDiff = fabs(relativeGoalPitch - endPitchPathList[i]);
-            if (pitchDiff > pitchDiffLimit) {
-              pitchDiff = pitchDiffLimit;
-            }
-            float yawDiff = fabs(relativeGoalYaw - endYawPathList[i]);
-            if (yawDiff > 180.0) {
-              yawDiff = 360.0 - yawDiff;
-            }
-
-            float score = (1 - pitchWeight * pitchDiff) * (1 - yawWeight * yawDiff);
-            if (score < 0) score = 0;
-            clearPathPerGroupScore[pathList[i]] += score + 0.000001;
-          }
-        }
-
-        float maxScore = 0;
-        int selectedGroupID = -1;
-        for (int i = 0; i < groupNum; i++) {
-          if (maxScore < clearPathPerGroupScore[i]) {
-            maxScore = clearPathPerGroupScore[i];
-            selectedGroupID = i;
-          }
-        }
+      ScopedStageTimer extractionTimer(stageProfiler, stagePathExtraction);
+      if (selectedScaleID >= 0) {
+        PathSearch& search = pathSearches[selectedScaleID];
+        double searchScale = search.pathScale;
+        int selectedGroupID = search.selectedGroupID;
 
         if (selectedGroupID >= 0 && (relativeGoalDis > stopDis || relativeGoalX > 0)) {
-          int selectedPathLength = startPaths[selectedGroupID]->points.size();
+          int selectedPathStart = startPathStart[selectedGroupID];
+          int selectedPathLength = startPathStart[selectedGroupID + 1] - selectedPathStart;
           path.poses.resize(selectedPathLength);
           for (int i = 0; i < selectedPathLength; i++) {
-            float x = startPaths[selectedGroupID]->points[i].x;
-            float y = startPaths[selectedGroupID]->points[i].y;
-            float z = startPaths[selectedGroupID]->points[i].z;
+            float x = startPathX[selectedPathStart + i];
+            float y = startPathY[selectedPathStart + i];
+            float z = startPathZ[selectedPathStart + i];
             float dis = sqrt(x * x + y * y);
 
-            if (dis <= relativeGoalDis / pathScale || relativeGoalX < 0) {
-              path.poses[i].pose.position.x = pathScale * x;
-              path.poses[i].pose.position.y = pathScale * y;
-              path.poses[i].pose.position.z = pathScale * z;
+            if (dis <= relativeGoalDis / searchScale || relativeGoalX < 0) {
+              path.poses[i].pose.position.x = searchScale * x;
+              path.poses[i].pose.position.y = searchScale * y;
+              path.poses[i].pose.position.z = searchScale * z;
             } else {
               path.poses.resize(i);
               break;
             }
           }
 
-          path.header.stamp = ros::Time().fromSec(laserTime);
+          path.header.stamp = ros::Time().fromSec(plannerCloudTime);
           path.header.frame_id = "track_point";
           pubPath.publish(path);
           pathPublished = true;
+          pathPublishTime = ros::Time::now().toSec();
 
-          #if PLOTPATHSET == 1
-          freePaths->clear();
-          pcl::PointXYZI point;
-          for (int i = 0; i < pathNum; i++) {
-            if (clearPathList[i] < pointPerPathThre) {
-              int freePathLength = paths[i]->points.size();
-              for (int j = 0; j < freePathLength; j++) {
-                point = paths[i]->points[j];
-                float dis = sqrt(point.x * point.x + point.y * point.y);
-                if (dis <= (relativeGoalDis + stopDis) / pathScale || relativeGoalX < 0) {
-                  point.x *= pathScale;
-                  point.y *= pathScale;
-                  point.z *= pathScale;
-
-                  freePaths->push_back(point);
-                }
+          if (visualizationFrame != NULL && visualizationFrame->publishFreePaths) {
+            for (int i = 0; i < pathNum; i++) {
+              if (search.clearPathList[i] < pointPerPathThre) {
+                visualizationFrame->freePathList.push_back(i);
               }
             }
+            visualizationFrame->pathScale = searchScale;
+            visualizationFrame->relativeGoalDis = relativeGoalDis;
+            visualizationFrame->relativeGoalX = relativeGoalX;
           }
-
-          sensor_msgs::PointCloud2 freePaths2;
-          pcl::toROSMsg(*freePaths, freePaths2);
-          freePaths2.header.stamp = ros::Time().fromSec(laserTime);
-          freePaths2.header.frame_id = "track_point";
-          pubFreePaths.publish(freePaths2);
-          #endif
-        }
-
-        if (selectedGroupID < 0) {
-          pathScale -= pathScaleStep;
-        } else {
-          break;
         }
       }
-      pathScale = pathScaleOri;
 
       if (!pathPublished) {
         path.poses.resize(1);
@@ -876,24 +867,50 @@ int main(int argc, char** argv)
         path.poses[0].pose.position.y = 0;
         path.poses[0].pose.position.z = 0;
 
-        path.header.stamp = ros::Time().fromSec(laserTime);
+        path.header.stamp = ros::Time().fromSec(plannerCloudTime);
         path.header.frame_id = "track_point";
         pubPath.publish(path);
+        pathPublishTime = ros::Time::now().toSec();
+      }
+
+      extractionTimer.stop();
 
-        #if PLOTPATHSET == 1
-        freePaths->clear();
-        sensor_msgs::PointCloud2 freePaths2;
-        pcl::toROSMsg(*freePaths, freePaths2);
-        freePaths2.header.stamp = ros::Time().fromSec(laserTime);
-        freePaths2.header.frame_id = "track_point";
-        pubFreePaths.publish(freePaths2);
-        #endif
+      planningLatency.data = pathPublishTime - plannerCloudStamp;
+      pubPlanningLatency.publish(planningLatency);
+      if (stageProfiler.enabled()) {
+        int64_t latencyNs = int64_t(1.0e9 * planningLatency.data);
+        stageProfiler.record(stageScanToPath, StageProfiler::nowNs() - latencyNs, latencyNs);
+      }
+
+      if (visualizationFrame != NULL) {
+        visualizationSlot.publish();
+        { std::lock_guard<std::mutex> lock(visualizationMutex); }
+        visualizationCond.notify_one();
       }
     }
 
+    if (stageProfiler.enabled() && StageProfiler::nowNs() - diagnosticsTimeNs >= 1000000000) {
+      publishStageDiagnostics(pubDiagnostics);
+      diagnosticsTimeNs = StageProfiler::nowNs();
+    }
+
     status = ros::ok();
-    rate.sleep();
+    if (!eventDrivenPlanning) {
+      rate.sleep();
+    } else if (threadedIngest) {
+      std::unique_lock<std::mutex> lock(plannerFrameMutex);
+      plannerFrameCond.wait_for(lock, std::chrono::milliseconds(10),
+                                [] { return plannerFrameSlot.hasNewFrame(); });
+    } else {
+      ros::getGlobalCallbackQueue()->callAvailable(ros::WallDuration(0.01));
+    }
+  }
+
+  if (visualizer.joinable()) {
+    visualizer.join();
   }
+  stageProfiler.closeTrace();
+  plannerRecorder.close();
 
   return 0;
 }
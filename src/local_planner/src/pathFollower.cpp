@@ -2,7 +2,14 @@
 #include <time.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <atomic>
+#include <thread>
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
 
 #include <message_filters/subscriber.h>
 #include <message_filters/synchronizer.h>
@@ -15,6 +22,7 @@
 #include <sensor_msgs/PointCloud2.h>
 #include <sensor_msgs/Joy.h>
 #include <visualization_msgs/Marker.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
 
 #include <tf/transform_datatypes.h>
 #include <tf/transform_broadcaster.h>
@@ -25,13 +33,18 @@
 #include <pcl/filters/voxel_grid.h>
 #include <pcl/kdtree/kdtree_flann.h>
 
+#include "latestFrameSlot.h"
+#include "poseBuffer.h"
+#include "stageProfiler.h"
+#include "trackPathBuffer.h"
+#include "trajectoryLogger.h"
+
 using namespace std;
 
 const double PI = 3.1415926;
 
 string stateEstimationTopic = "/state_estimation";
-string desiredTrajFile;
-string executedTrajFile;
+string trajectoryLogFile;
 bool saveTrajectory = false;
 double saveTrajInverval = 0.1;
 bool waypointTest = false;
@@ -42,6 +55,14 @@ double waypointZ = 2.0;
 bool autonomyMode = false;
 int pubSkipNum = 1;
 int pubSkipCount = 0;
+double trackMarkerRate = 20.0;
+double trackOdomRate = 0;
+double trackTfRate = 50.0;
+double trackPathRate = 5.0;
+double controlRate = 0;
+int controlPriority = 0;
+int controlCpu = -1;
+double controlOdomTimeout = 0.2;
 bool trackingCamBackward = false;
 double trackingCamXOffset = 0;
 double trackingCamYOffset = 0;
@@ -49,6 +70,7 @@ double trackingCamZOffset = 0;
 double trackingCamScale = 1.0;
 double lookAheadScale = 0.2;
 double minLookAheadDis = 0.2;
+bool interpolateLookAhead = false;
 double minSpeed = 0.5;
 double maxSpeed = 2.0;
 double desiredSpeed = minSpeed;
@@ -88,18 +110,25 @@ double goalY = 0;
 double goalZ = 1.0;
 
 int trackPathID = 0;
-const int stackNum = 200;
-int trackPathIDStack[stackNum];
-double odomTimeStack[stackNum];
-float odomYawStack[stackNum];
-int odomSendIDPointer = -1;
-int odomRecIDPointer = 0;
+// track point sent at each odometry time, looked up by the stamp of the returned path,
+// adjustTrack is set if the track point followed the vehicle instead of the path
+struct TrackSample
+{
+  float x;
+  float y;
+  float z;
+  float yaw;
+  int trackPathID;
+  bool adjustTrack;
+};
+
+TimedRingBuffer<TrackSample> trackSamples(200);
 
 bool manualMode = true;
 bool autoAdjustMode = false;
 int stateInitDelay = 100;
 
-bool pathFound = true;
+std::atomic<bool> pathFound(true);
 double stopRotTime = 0;
 double slowTurnTime = 0;
 double autoModeTime = 0;
@@ -142,7 +171,11 @@ float vehicleAngRateZ = 0;
 
 visualization_msgs::Marker trackMarker;
 nav_msgs::Odometry trackOdom;
-nav_msgs::Path trackPath, trackPath2, trackPathShow;
+nav_msgs::Path trackPathShow, trackPathDelta;
+
+// followed trajectory, indexed by trackPathID, the newest trackPathShowNum points are published
+TrackPathBuffer trackPath(4096);
+const int trackPathShowNum = 500;
 geometry_msgs::TwistStamped control_cmd;
 std_msgs::Float32 autoMode;
 geometry_msgs::PointStamped waypoint;
@@ -151,15 +184,64 @@ tf::StampedTransform odomTrans;
 ros::Publisher *pubMarkerPointer;
 ros::Publisher *pubOdometryPointer;
 ros::Publisher *pubPathPointer;
+ros::Publisher *pubPathDeltaPointer;
 ros::Publisher *pubControlPointer;
 ros::Publisher *pubAutoModePointer;
 ros::Publisher *pubWaypointPointer;
 tf::TransformBroadcaster *tfBroadcasterPointer;
 
-FILE *desiredTrajFilePtr = NULL;
-FILE *executedTrajFilePtr = NULL;
+TrajectoryLogger trajectoryLogger;
 
-void stateEstimationHandler(const nav_msgs::Odometry::ConstPtr& odom)
+// limits an output to rate Hz by message time, rate 0 passes every message, time going backwards
+// (e.g. a restarted bag) passes and restarts the limit
+struct OutputRateLimit
+{
+  double rate;
+  double lastTime;
+
+  bool ready(double time)
+  {
+    if (rate > 0 && time >= lastTime && time < lastTime + 1.0 / rate) {
+      return false;
+    }
+    lastTime = time;
+    return true;
+  }
+};
+
+OutputRateLimit trackMarkerLimit = {0, -1.0e9};
+OutputRateLimit trackOdomLimit = {0, -1.0e9};
+OutputRateLimit trackTfLimit = {0, -1.0e9};
+OutputRateLimit trackPathLimit = {0, -1.0e9};
+
+// with controlRate set, the control law runs on its own thread at that rate on the latest
+// odometry. The odometry callback only hands the message over, the path callback splices the
+// path into its own copy of the track path and hands the finished ring over, the control
+// thread swaps it in for the ring it follows.
+struct OdometrySnapshot
+{
+  nav_msgs::Odometry::ConstPtr odom;
+  int64_t receiveNs;
+};
+
+LatestFrameSlot<OdometrySnapshot> odometrySlot;
+LatestFrameSlot<TrackPathBuffer> trackPathSlot;
+TrackPathBuffer trackPathSplice(4096);
+
+enum ControlStage
+{
+  stageControlWakeup,
+  stageControlStep,
+  stageControlOdomAge,
+  controlStageNum
+};
+
+const char *controlStageNames[controlStageNum] = {"control_wakeup", "control_step", "odom_age"};
+StageProfiler controlProfiler;
+
+// with shiftGoalAtStart, the goal is shifted by the odometry after stateInitDelay messages,
+// returns false for the messages up to then
+bool shiftGoalAtStartup(const nav_msgs::Odometry::ConstPtr& odom)
 {
   if (stateInitDelay >= 0 && shiftGoalAtStart) {
     if (stateInitDelay == 0) {
@@ -168,16 +250,17 @@ void stateEstimationHandler(const nav_msgs::Odometry::ConstPtr& odom)
       goalZ += trackingCamScale * odom->pose.pose.position.z;
     }
     stateInitDelay--;
-    return;
+    return false;
   }
 
-  pubSkipCount--;
-  if (pubSkipCount >= 0) {
-    return;
-  } else {
-    pubSkipCount = pubSkipNum;
-  }
+  return true;
+}
 
+// runs the control law on the odometry, newOdometry is false when the control thread runs it
+// again on the same message, the track sample and the outputs other than the control are
+// then left out
+void followPath(const nav_msgs::Odometry::ConstPtr& odom, bool newOdometry)
+{
   double odomTime = odom->header.stamp.toSec();
 
   double roll, pitch, yaw;
@@ -307,9 +390,9 @@ void stateEstimationHandler(const nav_msgs::Odometry::ConstPtr& odom)
     control_cmd.twist.linear.z = manualSpeedZ * joyUp;
     control_cmd.twist.angular.z = manualYawRate * joyYaw * PI / 180.0;
   } else {
-    trackX = trackPath.poses[trackPathID].pose.position.x;
-    trackY = trackPath.poses[trackPathID].pose.position.y;
-    trackZ = trackPath.poses[trackPathID].pose.position.z;
+    trackX = trackPath[trackPathID].x;
+    trackY = trackPath[trackPathID].y;
+    trackZ = trackPath[trackPathID].z;
 
     if (joyFwdDb < joyFwd) joyFwdDb = joyFwd;
     else if (joyFwdDb > joyFwd + joyDeadband) joyFwdDb = joyFwd + joyDeadband;
@@ -328,11 +411,11 @@ void stateEstimationHandler(const nav_msgs::Odometry::ConstPtr& odom)
     float disZ = trackZ - vehicleZ;
     float dis = sqrt(disX * disX + disY * disY);
 
-    int trackPathLength = trackPath.poses.size();
+    int trackPathLength = trackPath.end();
     while (trackPathID < trackPathLength - 1) {
-      float trackNextX = trackPath.poses[trackPathID + 1].pose.position.x;
-      float trackNextY = trackPath.poses[trackPathID + 1].pose.position.y;
-      float trackNextZ = trackPath.poses[trackPathID + 1].pose.position.z;
+      float trackNextX = trackPath[trackPathID + 1].x;
+      float trackNextY = trackPath[trackPathID + 1].y;
+      float trackNextZ = trackPath[trackPathID + 1].z;
 
       float disNextX = trackNextX - vehicleX;
       float disNextY = trackNextY - vehicleY;
@@ -352,24 +435,38 @@ void stateEstimationHandler(const nav_msgs::Odometry::ConstPtr& odom)
 
     float curv = 0;
     float slope = 0;
-    if (trackPathID > 0) {
-      float deltaX = trackX - trackPath.poses[trackPathID - 1].pose.position.x;
-      float deltaY = trackY - trackPath.poses[trackPathID - 1].pose.position.y;
-      float deltaZ = trackZ - trackPath.poses[trackPathID - 1].pose.position.z;
-      trackYaw = atan2(deltaY, deltaX);
-
-      float deltaDis = sqrt(deltaX * deltaX + deltaY * deltaY);
-      if (deltaDis > 0.001 && trackPathID < trackPathLength - 1) {
-        deltaX = trackPath.poses[trackPathID + 1].pose.position.x - trackPath.poses[trackPathID].pose.position.x;
-        deltaY = trackPath.poses[trackPathID + 1].pose.position.y - trackPath.poses[trackPathID].pose.position.y;
-        float trackNextYaw = atan2(deltaY, deltaX);
-
-        float deltaYaw = trackNextYaw - trackYaw;
-        if (deltaYaw > PI) deltaYaw -= 2 * PI;
-        else if (deltaYaw < -PI) deltaYaw += 2 * PI;
-
-        curv = deltaYaw / deltaDis;
-        slope = deltaZ / deltaDis;
+    if (trackPathID > trackPath.begin()) {
+      const TrackPoint& trackPoint = trackPath[trackPathID];
+      trackYaw = trackPoint.yaw;
+      if (trackPathID < trackPathLength - 1) {
+        curv = trackPoint.curv;
+        slope = trackPoint.slope;
+      }
+
+      // the track point is moved on along the next segment to where it is lookAheadDis away,
+      // blending heading, curvature and slope towards the next point
+      if (interpolateLookAhead && trackPathID < trackPathLength - 1 && dis < lookAheadDis) {
+        const TrackPoint& trackNextPoint = trackPath[trackPathID + 1];
+        float disNextX = trackNextPoint.x - vehicleX;
+        float disNextY = trackNextPoint.y - vehicleY;
+        float disNext = sqrt(disNextX * disNextX + disNextY * disNextY);
+
+        if (disNext > lookAheadDis) {
+          float ratio = (lookAheadDis - dis) / (disNext - dis);
+          trackX += ratio * (trackNextPoint.x - trackX);
+          trackY += ratio * (trackNextPoint.y - trackY);
+          trackZ += ratio * (trackNextPoint.z - trackZ);
+
+          float deltaYaw = trackNextPoint.yaw - trackYaw;
+          if (deltaYaw > PI) deltaYaw -= 2 * PI;
+          else if (deltaYaw < -PI) deltaYaw += 2 * PI;
+          trackYaw += ratio * deltaYaw;
+
+          if (trackPathID + 1 < trackPathLength - 1) {
+            curv += ratio * (trackNextPoint.curv - curv);
+            slope += ratio * (trackNextPoint.slope - slope);
+          }
+        }
       }
     }
 
@@ -415,8 +512,8 @@ void stateEstimationHandler(const nav_msgs::Odometry::ConstPtr& odom)
     }
 
     float deltaZ = 0;
-    if (trackPathID > 0) {
-      deltaZ = trackZ - trackPath.poses[trackPathID - 1].pose.position.z;
+    if (trackPathID > trackPath.begin()) {
+      deltaZ = trackZ - trackPath[trackPathID - 1].z;
     }
     if (fabs(deltaZ) < 0.001) {
       velZPath = 0;
@@ -470,10 +567,11 @@ void stateEstimationHandler(const nav_msgs::Odometry::ConstPtr& odom)
     control_cmd.twist.angular.z = desiredYawRate;
   }
 
-  odomSendIDPointer = (odomSendIDPointer + 1) % stackNum;
-  odomTimeStack[odomSendIDPointer] = odomTime;
-  odomYawStack[odomSendIDPointer] = trackYaw;
-  trackPathIDStack[odomSendIDPointer] = trackPathID;
+  if (newOdometry) {
+    TrackSample trackSample = {trackX, trackY, trackZ, trackYaw, trackPathID,
+                               manualMode || (autonomyMode && autoAdjustMode)};
+    trackSamples.push(odomTime, trackSample);
+  }
 
   if (autonomyMode && waypointTest) {
     if (odomTime - waypointTime > waypointInterval) {
@@ -515,8 +613,9 @@ void stateEstimationHandler(const nav_msgs::Odometry::ConstPtr& odom)
     float dis2 = sqrt(disX2 * disX2 + disY2 * disY2 + disZ2 * disZ2);
 
     if (dis > saveTrajInverval && dis2 > saveTrajInverval) {
-      fprintf(desiredTrajFilePtr, "%f %f %f %f %lf\n", trackX, trackY, trackZ, trackYaw, odomTime);
-      fprintf(executedTrajFilePtr, "%f %f %f %f %f %f %lf\n", vehicleX, vehicleY, vehicleZ, roll, pitch, yaw, odomTime);
+      TrajectoryRecord record = {odomTime, trackX, trackY, trackZ, trackYaw, vehicleX, vehicleY, vehicleZ,
+                                 float(roll), float(pitch), float(yaw)};
+      trajectoryLogger.log(record);
 
       trackRecX = trackX;
       trackRecY = trackY;
@@ -532,136 +631,199 @@ void stateEstimationHandler(const nav_msgs::Odometry::ConstPtr& odom)
   control_cmd.header.frame_id = "vehicle";
   pubControlPointer->publish(control_cmd);
 
-  trackMarker.header.stamp = odom->header.stamp;
-  trackMarker.header.frame_id = "map";
-  trackMarker.ns = "track_point";
-  trackMarker.id = 0;
-  trackMarker.type = visualization_msgs::Marker::SPHERE;
-  trackMarker.action = visualization_msgs::Marker::ADD;
-  trackMarker.scale.x = 0.2;
-  trackMarker.scale.y = 0.2;
-  trackMarker.scale.z = 0.2;
-  trackMarker.color.a = 1.0;
-  trackMarker.color.r = 1.0;
-  trackMarker.pose.position.x = trackX;
-  trackMarker.pose.position.y = trackY;
-  trackMarker.pose.position.z = trackZ;
-  pubMarkerPointer->publish(trackMarker);
+  if (!newOdometry) {
+    return;
+  }
 
-  geoQuat = tf::createQuaternionMsgFromRollPitchYaw(0, trackPitch, trackYaw);
+  // only the control output is published every cycle
+  if (pubMarkerPointer->getNumSubscribers() > 0 && trackMarkerLimit.ready(odomTime)) {
+    trackMarker.header.stamp = odom->header.stamp;
+    trackMarker.header.frame_id = "map";
+    trackMarker.ns = "track_point";
+    trackMarker.id = 0;
+    trackMarker.type = visualization_msgs::Marker::SPHERE;
+    trackMarker.action = visualization_msgs::Marker::ADD;
+    trackMarker.scale.x = 0.2;
+    trackMarker.scale.y = 0.2;
+    trackMarker.scale.z = 0.2;
+    trackMarker.color.a = 1.0;
+    trackMarker.color.r = 1.0;
+    trackMarker.pose.position.x = trackX;
+    trackMarker.pose.position.y = trackY;
+    trackMarker.pose.position.z = trackZ;
+    pubMarkerPointer->publish(trackMarker);
+  }
 
-  trackOdom.header.stamp = odom->header.stamp;
-  trackOdom.header.frame_id = "map";
-  trackOdom.child_frame_id = "track_point";
-  trackOdom.pose.pose.orientation = geoQuat;
-  trackOdom.pose.pose.position.x = trackX;
-  trackOdom.pose.pose.position.y = trackY;
-  trackOdom.pose.pose.position.z = trackZ;
-  trackOdom.twist.twist.angular.x = roll;
-  trackOdom.twist.twist.angular.y = pitch;
-  trackOdom.twist.twist.angular.z = yaw;
-  trackOdom.twist.twist.linear.x = vehicleX;
-  trackOdom.twist.twist.linear.y = vehicleY;
-  trackOdom.twist.twist.linear.z = vehicleZ;
-  pubOdometryPointer->publish(trackOdom);
-
-  odomTrans.stamp_ = odom->header.stamp;
-  odomTrans.frame_id_ = "map";
-  odomTrans.child_frame_id_ = "track_point";
-  odomTrans.setRotation(tf::Quaternion(geoQuat.x, geoQuat.y, geoQuat.z, geoQuat.w));
-  odomTrans.setOrigin(tf::Vector3(trackX, trackY, trackZ));
-  tfBroadcasterPointer->sendTransform(odomTrans);
-}
+  bool trackOdomReady = trackOdomLimit.ready(odomTime);
+  bool trackTfReady = trackTfLimit.ready(odomTime);
+  if (!trackOdomReady && !trackTfReady) {
+    return;
+  }
 
-void pathHandler(const nav_msgs::Path::ConstPtr& path)
-{
-  double pathTime = path->header.stamp.toSec();
+  geoQuat = tf::createQuaternionMsgFromRollPitchYaw(0, trackPitch, trackYaw);
 
-  int pathLength = path->poses.size();
-  if (pathLength > 1) {
-    pathFound = true;
-  } else {
-    pathLength = 1;
-    pathFound = false;
+  if (trackOdomReady) {
+    trackOdom.header.stamp = odom->header.stamp;
+    trackOdom.header.frame_id = "map";
+    trackOdom.child_frame_id = "track_point";
+    trackOdom.pose.pose.orientation = geoQuat;
+    trackOdom.pose.pose.position.x = trackX;
+    trackOdom.pose.pose.position.y = trackY;
+    trackOdom.pose.pose.position.z = trackZ;
+    trackOdom.twist.twist.angular.x = roll;
+    trackOdom.twist.twist.angular.y = pitch;
+    trackOdom.twist.twist.angular.z = yaw;
+    trackOdom.twist.twist.linear.x = vehicleX;
+    trackOdom.twist.twist.linear.y = vehicleY;
+    trackOdom.twist.twist.linear.z = vehicleZ;
+    pubOdometryPointer->publish(trackOdom);
   }
 
-  if (odomSendIDPointer < 0) {
-    return;
+  if (trackTfReady) {
+    odomTrans.stamp_ = odom->header.stamp;
+    odomTrans.frame_id_ = "map";
+    odomTrans.child_frame_id_ = "track_point";
+    odomTrans.setRotation(tf::Quaternion(geoQuat.x, geoQuat.y, geoQuat.z, geoQuat.w));
+    odomTrans.setOrigin(tf::Vector3(trackX, trackY, trackZ));
+    tfBroadcasterPointer->sendTransform(odomTrans);
   }
+}
 
-  while (odomRecIDPointer != (odomSendIDPointer + 1) % stackNum) {
-    int odomRecIDPointerNext = (odomRecIDPointer + 1) % stackNum;
-    if (fabs(pathTime - odomTimeStack[odomRecIDPointer]) < fabs(pathTime - odomTimeStack[odomRecIDPointerNext])) {
-      break;
-    }
-    odomRecIDPointer = (odomRecIDPointer + 1) % stackNum;
+void stateEstimationHandler(const nav_msgs::Odometry::ConstPtr& odom)
+{
+  if (!shiftGoalAtStartup(odom)) {
+    return;
   }
 
-  int trackPathRecID = trackPathIDStack[odomRecIDPointer];
-  if (trackPathRecID < 100) {
-    trackPath2 = trackPath;
-    trackPath.poses.resize(trackPathRecID + pathLength);
-    for (int i = 0; i <= trackPathRecID; i++) {
-      trackPath.poses[i] = trackPath2.poses[i];
-    }
+  pubSkipCount--;
+  if (pubSkipCount >= 0) {
+    return;
   } else {
-    trackPath2.poses.resize(101);
-    for (int i = 0; i <= 100; i++) {
-      trackPath2.poses[i] = trackPath.poses[trackPathRecID + i - 100];
-    }
-    trackPath.poses.resize(trackPathRecID + pathLength);
-    for (int i = 0; i <= 100; i++) {
-      trackPath.poses[trackPathRecID + i - 100] = trackPath2.poses[i];
-    }
+    pubSkipCount = pubSkipNum;
   }
 
-  if (manualMode || (autonomyMode && autoAdjustMode)) {
-    trackPath.poses[trackPathRecID].pose.position.x = trackX;
-    trackPath.poses[trackPathRecID].pose.position.y = trackY;
-    trackPath.poses[trackPathRecID].pose.position.z = trackZ;
-    if (trackPathRecID > 0) {
-      trackPath.poses[trackPathRecID - 1].pose.position.x = trackX - 0.1 * cos(trackYaw);
-      trackPath.poses[trackPathRecID - 1].pose.position.y = trackY - 0.1 * sin(trackYaw);
-      trackPath.poses[trackPathRecID - 1].pose.position.z = trackZ;
+  followPath(odom, true);
+}
+
+// splices the path into the ring after the track point of the sample, the path is in the frame
+// of that track point, with adjustTrack the track point and the one before it are moved to the
+// sampled position first. Returns the track point index, or -1 if it has dropped out of the
+// ring, deltaStart is set to the first point changed.
+int splicePath(TrackPathBuffer& ring, const nav_msgs::Path& path, const TrackSample& trackSample, int& deltaStart)
+{
+  int trackPathRecID = trackSample.trackPathID;
+  if (!ring.contains(trackPathRecID)) {
+    return -1;
+  }
+  ring.truncate(trackPathRecID + 1);
+  deltaStart = trackPathRecID;
+
+  if (trackSample.adjustTrack) {
+    ring.set(trackPathRecID, trackSample.x, trackSample.y, trackSample.z);
+    if (trackPathRecID > ring.begin()) {
+      deltaStart = trackPathRecID - 1;
+      ring.set(trackPathRecID - 1, trackSample.x - 0.1 * cos(trackSample.yaw),
+               trackSample.y - 0.1 * sin(trackSample.yaw), trackSample.z);
     }
-    odomYawStack[odomRecIDPointer] = trackYaw;
   }
 
-  trackX = trackPath.poses[trackPathRecID].pose.position.x;
-  trackY = trackPath.poses[trackPathRecID].pose.position.y;
-  trackZ = trackPath.poses[trackPathRecID].pose.position.z;
-  trackYaw = odomYawStack[odomRecIDPointer];
+  float spliceX = ring[trackPathRecID].x;
+  float spliceY = ring[trackPathRecID].y;
+  float spliceZ = ring[trackPathRecID].z;
 
   float sinTrackPitch = sin(trackPitch);
   float cosTrackPitch = cos(trackPitch);
-  float sinTrackYaw = sin(trackYaw);
-  float cosTrackYaw = cos(trackYaw);
+  float sinTrackYaw = sin(trackSample.yaw);
+  float cosTrackYaw = cos(trackSample.yaw);
 
+  int pathLength = path.poses.size();
   for (int i = 1; i < pathLength; i++) {
-    float trackX2 = cosTrackPitch * path->poses[i].pose.position.x + sinTrackPitch * path->poses[i].pose.position.z;
-    float trackY2 = path->poses[i].pose.position.y;
-    float trackZ2 = -sinTrackPitch * path->poses[i].pose.position.x + cosTrackPitch * path->poses[i].pose.position.z;
+    float trackX2 = cosTrackPitch * path.poses[i].pose.position.x + sinTrackPitch * path.poses[i].pose.position.z;
+    float trackY2 = path.poses[i].pose.position.y;
+    float trackZ2 = -sinTrackPitch * path.poses[i].pose.position.x + cosTrackPitch * path.poses[i].pose.position.z;
 
-    trackPath.poses[trackPathRecID + i].pose.position.x = cosTrackYaw * trackX2 - sinTrackYaw * trackY2 + trackX;
-    trackPath.poses[trackPathRecID + i].pose.position.y = sinTrackYaw * trackX2 + cosTrackYaw * trackY2 + trackY;
-    trackPath.poses[trackPathRecID + i].pose.position.z = trackZ2 + trackZ;
+    ring.push(cosTrackYaw * trackX2 - sinTrackYaw * trackY2 + spliceX,
+              sinTrackYaw * trackX2 + cosTrackYaw * trackY2 + spliceY, trackZ2 + spliceZ);
   }
 
-  int trackPathLength = trackPath.poses.size();
-  if (trackPathLength < 500) {
-    trackPathShow = trackPath;
-  } else {
-    trackPathShow.poses.resize(500);
-    for (int i = 0; i < 500; i++) {
-      trackPathShow.poses[i] = trackPath.poses[trackPathLength + i - 500];
+  return trackPathRecID;
+}
+
+// the delta holds the points replaced by the last path, header.seq of each pose is its index in
+// the track path, a listener drops its points from the first index on and appends the delta
+void publishTrackPath(const TrackPathBuffer& ring, int deltaStart, const ros::Time& stamp)
+{
+  if (pubPathDeltaPointer->getNumSubscribers() > 0) {
+    int trackPathDeltaLength = ring.end() - deltaStart;
+    trackPathDelta.poses.resize(trackPathDeltaLength);
+    for (int i = 0; i < trackPathDeltaLength; i++) {
+      const TrackPoint& point = ring[deltaStart + i];
+      trackPathDelta.poses[i].header.seq = deltaStart + i;
+      trackPathDelta.poses[i].pose.position.x = point.x;
+      trackPathDelta.poses[i].pose.position.y = point.y;
+      trackPathDelta.poses[i].pose.position.z = point.z;
     }
+
+    trackPathDelta.header.stamp = stamp;
+    trackPathDelta.header.frame_id = "map";
+    pubPathDeltaPointer->publish(trackPathDelta);
+  }
+
+  if (pubPathPointer->getNumSubscribers() == 0 || !trackPathLimit.ready(stamp.toSec())) {
+    return;
+  }
+
+  int trackPathShowStart = ring.end() - trackPathShowNum;
+  if (trackPathShowStart < ring.begin()) trackPathShowStart = ring.begin();
+  int trackPathShowLength = ring.end() - trackPathShowStart;
+  trackPathShow.poses.resize(trackPathShowLength);
+  for (int i = 0; i < trackPathShowLength; i++) {
+    const TrackPoint& point = ring[trackPathShowStart + i];
+    trackPathShow.poses[i].pose.position.x = point.x;
+    trackPathShow.poses[i].pose.position.y = point.y;
+    trackPathShow.poses[i].pose.position.z = point.z;
   }
 
-  trackPathShow.header.stamp = path->header.stamp;
+  trackPathShow.header.stamp = stamp;
   trackPathShow.header.frame_id = "map";
   pubPathPointer->publish(trackPathShow);
 }
 
+void pathHandler(const nav_msgs::Path::ConstPtr& path)
+{
+  double pathTime = path->header.stamp.toSec();
+  pathFound = path->poses.size() > 1;
+
+  int64_t trackSampleID;
+  TrackSample trackSample;
+  if (!trackSamples.nearest(pathTime, trackSampleID, trackSample)) {
+    return;
+  }
+
+  // the track point is moved to where it is now, not where it was at the sample
+  trackSample.adjustTrack = manualMode || (autonomyMode && autoAdjustMode);
+  if (trackSample.adjustTrack) {
+    trackSample.x = trackX;
+    trackSample.y = trackY;
+    trackSample.z = trackZ;
+    trackSample.yaw = trackYaw;
+  }
+  trackSamples.set(trackSampleID, trackSample);
+
+  int trackPathDeltaStart;
+  int trackPathRecID = splicePath(trackPath, *path, trackSample, trackPathDeltaStart);
+  if (trackPathRecID < 0) {
+    return;
+  }
+
+  trackX = trackPath[trackPathRecID].x;
+  trackY = trackPath[trackPathRecID].y;
+  trackZ = trackPath[trackPathRecID].z;
+  trackYaw = trackSample.yaw;
+
+  publishTrackPath(trackPath, trackPathDeltaStart, path->header.stamp);
+}
+
 void joystickHandler(const sensor_msgs::Joy::ConstPtr& joy)
 {
   joyTime = ros::Time::now().toSec();
@@ -720,6 +882,132 @@ void speedHandler(const std_msgs::Float32::ConstPtr& speed)
   }
 }
 
+void odometrySlotHandler(const nav_msgs::Odometry::ConstPtr& odom)
+{
+  OdometrySnapshot& snapshot = odometrySlot.writeBuffer();
+  snapshot.odom = odom;
+  snapshot.receiveNs = StageProfiler::nowNs();
+  odometrySlot.publish();
+}
+
+// the track samples are written by the control thread, nearest() copies the sample under the
+// slot's sequence number and retries if the control thread overwrote it during the lookup
+void pathSlotHandler(const nav_msgs::Path::ConstPtr& path)
+{
+  double pathTime = path->header.stamp.toSec();
+  pathFound = path->poses.size() > 1;
+
+  int64_t trackSampleID;
+  TrackSample trackSample;
+  if (!trackSamples.nearest(pathTime, trackSampleID, trackSample)) {
+    return;
+  }
+
+  int trackPathDeltaStart;
+  if (splicePath(trackPathSplice, *path, trackSample, trackPathDeltaStart) < 0) {
+    return;
+  }
+
+  trackPathSlot.writeBuffer() = trackPathSplice;
+  trackPathSlot.publish();
+
+  publishTrackPath(trackPathSplice, trackPathDeltaStart, path->header.stamp);
+}
+
+// runs the control law every 1 / controlRate s on an absolute schedule, a track path handed
+// over since the last cycle is swapped in first, the joystick, goal and speed callbacks are
+// served here so that all control state stays on this thread. The per-message steps run only
+// on new odometry, pubSkipNum does not apply, and the control is paused if the odometry is
+// older than controlOdomTimeout.
+void controlThread(ros::CallbackQueue *controlQueue)
+{
+  if (controlPriority > 0) {
+    sched_param schedParam;
+    schedParam.sched_priority = controlPriority;
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &schedParam) != 0) {
+      printf ("\nCannot set SCHED_FIFO priority %d for the control thread.\n", controlPriority);
+    }
+  }
+
+  if (controlCpu >= 0) {
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(controlCpu, &cpuSet);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) != 0) {
+      printf ("\nCannot pin the control thread to CPU %d.\n", controlCpu);
+    }
+  }
+
+  // StageProfiler::nowNs() reads steady_clock, which is CLOCK_MONOTONIC
+  int64_t periodNs = int64_t(1.0e9 / controlRate);
+  int64_t wakeNs = StageProfiler::nowNs();
+  bool odometryReady = false;
+  while (ros::ok()) {
+    wakeNs += periodNs;
+    timespec wakeTime;
+    wakeTime.tv_sec = wakeNs / 1000000000;
+    wakeTime.tv_nsec = wakeNs % 1000000000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeTime, NULL) == EINTR) {}
+
+    int64_t startNs = StageProfiler::nowNs();
+    controlProfiler.record(stageControlWakeup, wakeNs, startNs - wakeNs);
+
+    // cycles missed by an overrun are skipped rather than run back to back
+    if (startNs - wakeNs > periodNs) wakeNs += (startNs - wakeNs) / periodNs * periodNs;
+
+    controlQueue->callAvailable();
+
+    if (trackPathSlot.update()) {
+      trackPath.swap(trackPathSlot.readBuffer());
+      if (trackPathID < trackPath.begin()) trackPathID = trackPath.begin();
+      else if (trackPathID >= trackPath.end()) trackPathID = trackPath.end() - 1;
+    }
+
+    bool newOdometry = odometrySlot.update();
+    const OdometrySnapshot& snapshot = odometrySlot.readBuffer();
+    if (newOdometry) {
+      odometryReady = shiftGoalAtStartup(snapshot.odom);
+    }
+
+    if (odometryReady && startNs - snapshot.receiveNs < controlOdomTimeout * 1.0e9) {
+      controlProfiler.record(stageControlOdomAge, snapshot.receiveNs, startNs - snapshot.receiveNs);
+      followPath(snapshot.odom, newOdometry);
+    }
+
+    controlProfiler.record(stageControlStep, startNs, StageProfiler::nowNs() - startNs);
+  }
+}
+
+// publishes the control loop timings since the last call
+void publishControlDiagnostics(ros::Publisher& pubDiagnostics)
+{
+  diagnostic_msgs::DiagnosticArray diagnostics;
+  diagnostics.header.stamp = ros::Time::now();
+
+  StageStats stats;
+  for (int i = 0; i < controlStageNum; i++) {
+    controlProfiler.snapshot(i, stats);
+    if (stats.count == 0) continue;
+
+    char str[100];
+    snprintf(str, sizeof(str), "p50 %.3f ms, p99 %.3f ms, max %.3f ms", stats.p50Ms, stats.p99Ms, stats.maxMs);
+
+    diagnostic_msgs::DiagnosticStatus status;
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.name = "pathFollower: " + controlProfiler.stageName(i);
+    status.hardware_id = "local_planner";
+    status.message = str;
+    addDiagnosticValue(status, "count", stats.count);
+    addDiagnosticValue(status, "mean_ms", stats.meanMs);
+    addDiagnosticValue(status, "p50_ms", stats.p50Ms);
+    addDiagnosticValue(status, "p99_ms", stats.p99Ms);
+    addDiagnosticValue(status, "max_ms", stats.maxMs);
+    diagnostics.status.push_back(status);
+  }
+
+  pubDiagnostics.publish(diagnostics);
+}
+
 int main(int argc, char** argv)
 {
   ros::init(argc, argv, "pathFollower");
@@ -727,8 +1015,7 @@ int main(int argc, char** argv)
   ros::NodeHandle nhPrivate = ros::NodeHandle("~");
 
   nhPrivate.getParam("stateEstimationTopic", stateEstimationTopic);
-  nhPrivate.getParam("desiredTrajFile", desiredTrajFile);
-  nhPrivate.getParam("executedTrajFile", executedTrajFile);
+  nhPrivate.getParam("trajectoryLogFile", trajectoryLogFile);
   nhPrivate.getParam("saveTrajectory", saveTrajectory);
   nhPrivate.getParam("saveTrajInverval", saveTrajInverval);
   nhPrivate.getParam("waypointTest", waypointTest);
@@ -738,6 +1025,14 @@ int main(int argc, char** argv)
   nhPrivate.getParam("waypointZ", waypointZ);
   nhPrivate.getParam("autonomyMode", autonomyMode);
   nhPrivate.getParam("pubSkipNum", pubSkipNum);
+  nhPrivate.getParam("trackMarkerRate", trackMarkerRate);
+  nhPrivate.getParam("trackOdomRate", trackOdomRate);
+  nhPrivate.getParam("trackTfRate", trackTfRate);
+  nhPrivate.getParam("trackPathRate", trackPathRate);
+  nhPrivate.getParam("controlRate", controlRate);
+  nhPrivate.getParam("controlPriority", controlPriority);
+  nhPrivate.getParam("controlCpu", controlCpu);
+  nhPrivate.getParam("controlOdomTimeout", controlOdomTimeout);
   nhPrivate.getParam("trackingCamBackward", trackingCamBackward);
   nhPrivate.getParam("trackingCamXOffset", trackingCamXOffset);
   nhPrivate.getParam("trackingCamYOffset", trackingCamYOffset);
@@ -746,6 +1041,7 @@ int main(int argc, char** argv)
   nhPrivate.getParam("trackPitch", trackPitch);
   nhPrivate.getParam("lookAheadScale", lookAheadScale);
   nhPrivate.getParam("minLookAheadDis", minLookAheadDis);
+  nhPrivate.getParam("interpolateLookAhead", interpolateLookAhead);
   nhPrivate.getParam("minSpeed", minSpeed);
   nhPrivate.getParam("maxSpeed", maxSpeed);
   nhPrivate.getParam("accXYGain", accXYGain);
@@ -789,25 +1085,36 @@ int main(int argc, char** argv)
     joyFwd = 1.0;
   }
 
-  trackPath.poses.resize(1);
-  trackPath.poses[0].pose.position.x = 0;
-  trackPath.poses[0].pose.position.y = 0;
-  trackPath.poses[0].pose.position.z = 1.0;
+  trackPath.reset(0, 0, 1.0);
+  trackPathSplice = trackPath;
 
-  if (saveTrajectory) {
-    desiredTrajFilePtr = fopen(desiredTrajFile.c_str(), "w");
-    executedTrajFilePtr = fopen(executedTrajFile.c_str(), "w");
+  trackMarkerLimit.rate = trackMarkerRate;
+  trackOdomLimit.rate = trackOdomRate;
+  trackTfLimit.rate = trackTfRate;
+  trackPathLimit.rate = trackPathRate;
+
+  if (saveTrajectory && !trajectoryLogger.open(trajectoryLogFile)) {
+    printf ("\nCannot write trajectory log %s.\n", trajectoryLogFile.c_str());
+    saveTrajectory = false;
+  }
+
+  // with controlRate set, the joystick, goal and speed callbacks are served by the control thread
+  ros::CallbackQueue controlQueue;
+  ros::NodeHandle nhControl;
+  if (controlRate > 0) {
+    nhControl.setCallbackQueue(&controlQueue);
   }
 
-  ros::Subscriber subStateEstimation = nh.subscribe<nav_msgs::Odometry> (stateEstimationTopic, 5, stateEstimationHandler);
+  ros::Subscriber subStateEstimation = nh.subscribe<nav_msgs::Odometry> (stateEstimationTopic, 5,
+                                       controlRate > 0 ? odometrySlotHandler : stateEstimationHandler);
 
-  ros::Subscriber subPath = nh.subscribe<nav_msgs::Path> ("/path", 5, pathHandler);
+  ros::Subscriber subPath = nh.subscribe<nav_msgs::Path> ("/path", 5, controlRate > 0 ? pathSlotHandler : pathHandler);
 
-  ros::Subscriber subJoystick = nh.subscribe<sensor_msgs::Joy> ("/joy", 5, joystickHandler);
+  ros::Subscriber subJoystick = nhControl.subscribe<sensor_msgs::Joy> ("/joy", 5, joystickHandler);
 
-  ros::Subscriber subGoal = nh.subscribe<geometry_msgs::PointStamped> ("/way_point", 5, goalHandler);
+  ros::Subscriber subGoal = nhControl.subscribe<geometry_msgs::PointStamped> ("/way_point", 5, goalHandler);
 
-  ros::Subscriber subSpeed = nh.subscribe<std_msgs::Float32> ("/speed", 5, speedHandler);
+  ros::Subscriber subSpeed = nhControl.subscribe<std_msgs::Float32> ("/speed", 5, speedHandler);
 
   ros::Publisher pubMarker = nh.advertise<visualization_msgs::Marker> ("/track_point_marker", 5);
   pubMarkerPointer = &pubMarker;
@@ -818,6 +1125,9 @@ int main(int argc, char** argv)
   ros::Publisher pubPath = nh.advertise<nav_msgs::Path> ("/track_path", 5);
   pubPathPointer = &pubPath;
 
+  ros::Publisher pubPathDelta = nh.advertise<nav_msgs::Path> ("/track_path_delta", 5);
+  pubPathDeltaPointer = &pubPathDelta;
+
   ros::Publisher pubControl = nh.advertise<geometry_msgs::TwistStamped> ("/attitude_control", 5);
   pubControlPointer = &pubControl;
 
@@ -830,13 +1140,32 @@ int main(int argc, char** argv)
   tf::TransformBroadcaster tfBroadcaster;
   tfBroadcasterPointer = &tfBroadcaster;
 
-  ros::spin();
+  if (controlRate > 0) {
+    ros::Publisher pubDiagnostics = nh.advertise<diagnostic_msgs::DiagnosticArray> ("/diagnostics", 5);
+
+    controlProfiler.init(controlStageNames, controlStageNum);
+    std::thread controller(controlThread, &controlQueue);
+
+    int64_t diagnosticsTimeNs = StageProfiler::nowNs();
+    while (ros::ok()) {
+      ros::getGlobalCallbackQueue()->callAvailable(ros::WallDuration(0.1));
+
+      if (StageProfiler::nowNs() - diagnosticsTimeNs >= 1000000000) {
+        publishControlDiagnostics(pubDiagnostics);
+        diagnosticsTimeNs = StageProfiler::nowNs();
+      }
+    }
+
+    controller.join();
+  } else {
+    ros::spin();
+  }
 
   if (saveTrajectory) {
-    fclose(desiredTrajFilePtr);
-    fclose(executedTrajFilePtr);
+    trajectoryLogger.close();
 
-    printf("\nTrajectories saved.\n\n");
+    printf("\nTrajectories saved to %s, %llu points dropped, convert with trajectoryExport.\n\n",
+           trajectoryLogFile.c_str(), (unsigned long long)trajectoryLogger.dropNum());
   }
 
   return 0;
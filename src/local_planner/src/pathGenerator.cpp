@@ -0,0 +1,545 @@
+#include <math.h>
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+using namespace std;
+
+// C++ port of paths/path_generator.m, writes startPaths.ply, paths.ply, pathList.ply and
+// correspondences.txt in the formats read by localPlanner
+
+const double PI = 3.1415926;
+
+string outputFolder = ".";
+
+// path generation
+double dis = 2.0;
+double horiAngle = 27.0;
+double vertAngle = 9.0;
+double scale = 0.65;
+
+// correspondence
+double voxelSize = 0.2;
+double searchRadiusHori = 1.2;
+double searchRadiusVert = 0.8;
+double sensorOffset = 0;
+double offsetX = 6.4;
+double offsetY = 9.0;
+double offsetZ = 3.3;
+int voxelNumX = 33;
+int voxelNumY = 91;
+int voxelNumZ = 34;
+int threadNum = 0;
+
+struct PathPoint
+{
+  float x, y, z;
+  int pathID, groupID;
+};
+
+vector<PathPoint> startPathPoints;
+vector<PathPoint> pathPoints;
+vector<PathPoint> pathEndPoints;
+int pathNum = 0;
+int groupNum = 0;
+
+// MATLAB a:d:b
+vector<double> colonRange(double a, double d, double b)
+{
+  vector<double> range;
+  if (d == 0 || (b - a) / d < 0) return range;
+
+  int num = int(floor((b - a) / d + 1e-10)) + 1;
+  for (int i = 0; i < num; i++) {
+    range.push_back(a + i * d);
+  }
+
+  return range;
+}
+
+// cubic spline with not-a-knot end conditions as MATLAB spline(), linear for 2 knots
+// and a parabola for 3 knots
+class Spline
+{
+public:
+  Spline(const vector<double>& x, const vector<double>& y) : x_(x), y_(y), m_(x.size(), 0)
+  {
+    int n = x_.size();
+    if (n < 3) return;
+
+    if (n == 3) {
+      double d1 = (y_[1] - y_[0]) / (x_[1] - x_[0]);
+      double d2 = (y_[2] - y_[1]) / (x_[2] - x_[1]);
+      double c = 2.0 * (d2 - d1) / (x_[2] - x_[0]);
+      m_[0] = m_[1] = m_[2] = c;
+      return;
+    }
+
+    vector<double> a(n * n, 0), b(n, 0);
+    double h0 = x_[1] - x_[0], h1 = x_[2] - x_[1];
+    a[0] = h1;
+    a[1] = -(h0 + h1);
+    a[2] = h0;
+
+    for (int i = 1; i < n - 1; i++) {
+      double hl = x_[i] - x_[i - 1];
+      double hr = x_[i + 1] - x_[i];
+      a[i * n + i - 1] = hl;
+      a[i * n + i] = 2.0 * (hl + hr);
+      a[i * n + i + 1] = hr;
+      b[i] = 6.0 * ((y_[i + 1] - y_[i]) / hr - (y_[i] - y_[i - 1]) / hl);
+    }
+
+    double hn2 = x_[n - 2] - x_[n - 3], hn1 = x_[n - 1] - x_[n - 2];
+    a[(n - 1) * n + n - 3] = hn1;
+    a[(n - 1) * n + n - 2] = -(hn2 + hn1);
+    a[(n - 1) * n + n - 1] = hn2;
+
+    for (int col = 0; col < n; col++) {
+      int pivot = col;
+      for (int row = col + 1; row < n; row++) {
+        if (fabs(a[row * n + col]) > fabs(a[pivot * n + col])) pivot = row;
+      }
+      if (pivot != col) {
+        for (int k = 0; k < n; k++) swap(a[col * n + k], a[pivot * n + k]);
+        swap(b[col], b[pivot]);
+      }
+
+      for (int row = col + 1; row < n; row++) {
+        double factor = a[row * n + col] / a[col * n + col];
+        if (factor == 0) continue;
+        for (int k = col; k < n; k++) a[row * n + k] -= factor * a[col * n + k];
+        b[row] -= factor * b[col];
+      }
+    }
+
+    for (int row = n - 1; row >= 0; row--) {
+      double sum = b[row];
+      for (int k = row + 1; k < n; k++) sum -= a[row * n + k] * m_[k];
+      m_[row] = sum / a[row * n + row];
+    }
+  }
+
+  double operator()(double xx) const
+  {
+    int n = x_.size();
+    if (n == 1) return y_[0];
+
+    int i = upper_bound(x_.begin(), x_.end(), xx) - x_.begin() - 1;
+    if (i < 0) i = 0;
+    else if (i > n - 2) i = n - 2;
+
+    double h = x_[i + 1] - x_[i];
+    double l = x_[i + 1] - xx;
+    double r = xx - x_[i];
+
+    return m_[i] * l * l * l / (6.0 * h) + m_[i + 1] * r * r * r / (6.0 * h)
+           + (y_[i] / h - m_[i] * h / 6.0) * l + (y_[i + 1] / h - m_[i + 1] * h / 6.0) * r;
+  }
+
+private:
+  vector<double> x_, y_, m_;
+};
+
+void generatePaths()
+{
+  double deltaHoriAngle = horiAngle / 2;
+  double deltaVertAngle = vertAngle / 1;
+
+  vector<double> pathStartR = colonRange(0, 0.1, dis);
+  int pathStartLength = pathStartR.size();
+
+  int pathID = 0;
+  int groupID = 0;
+
+  vector<double> shift11List = colonRange(-horiAngle, deltaHoriAngle, horiAngle);
+  vector<double> shift12List = colonRange(-2 * vertAngle, deltaVertAngle, 2 * vertAngle);
+  for (size_t i11 = 0; i11 < shift11List.size(); i11++) {
+    double shift11 = shift11List[i11];
+    for (size_t i12 = 0; i12 < shift12List.size(); i12++) {
+      double shift12 = shift12List[i12];
+
+      vector<double> startKnots, startHori, startVert;
+      startKnots.push_back(0);
+      startKnots.push_back(dis);
+      startHori.push_back(0);
+      startHori.push_back(shift11);
+      startVert.push_back(shift12);
+      startVert.push_back(shift12);
+      Spline startSplineHori(startKnots, startHori);
+      Spline startSplineVert(startKnots, startVert);
+
+      vector<double> pathStartShiftHori(pathStartLength), pathStartShiftVert(pathStartLength);
+      for (int i = 0; i < pathStartLength; i++) {
+        double r = pathStartR[i];
+        pathStartShiftHori[i] = startSplineHori(r);
+        pathStartShiftVert[i] = startSplineVert(r);
+
+        PathPoint point;
+        point.x = r * cos(pathStartShiftHori[i] * PI / 180);
+        point.y = r * sin(pathStartShiftHori[i] * PI / 180);
+        point.z = r * sin(pathStartShiftVert[i] * PI / 180);
+        point.pathID = -1;
+        point.groupID = groupID;
+        startPathPoints.push_back(point);
+      }
+
+      vector<double> shift21List = colonRange(-horiAngle * scale + shift11, deltaHoriAngle * scale, horiAngle * scale + shift11);
+      vector<double> shift22List = colonRange(-vertAngle * scale + shift12, deltaVertAngle * scale, vertAngle * scale + shift12);
+      for (size_t i21 = 0; i21 < shift21List.size(); i21++) {
+        double shift21 = shift21List[i21];
+        for (size_t i22 = 0; i22 < shift22List.size(); i22++) {
+          double shift22 = shift22List[i22];
+
+          vector<double> shift31List = colonRange(-horiAngle * scale * scale + shift21, deltaHoriAngle * scale * scale,
+                                                  horiAngle * scale * scale + shift21);
+          vector<double> shift32List = colonRange(-vertAngle * scale * scale + shift22, deltaVertAngle * scale * scale,
+                                                  vertAngle * scale * scale + shift22);
+          for (size_t i31 = 0; i31 < shift31List.size(); i31++) {
+            double shift31 = shift31List[i31];
+            for (size_t i32 = 0; i32 < shift32List.size(); i32++) {
+              double shift32 = shift32List[i32];
+              if (fabs(shift32) > 2 * vertAngle) {
+                continue;
+              }
+
+              vector<double> knots(pathStartR), hori(pathStartShiftHori), vert(pathStartShiftVert);
+              knots.push_back(2 * dis);
+              hori.push_back(shift21);
+              vert.push_back(shift22);
+              knots.push_back(3 * dis - 0.001);
+              hori.push_back(shift31);
+              vert.push_back(shift32);
+              knots.push_back(3 * dis);
+              hori.push_back(shift31);
+              vert.push_back(shift32);
+              Spline splineHori(knots, hori);
+              Spline splineVert(knots, vert);
+
+              vector<double> pathR = colonRange(0, 0.1, knots.back());
+              int pathLength = pathR.size();
+              for (int i = 0; i < pathLength; i++) {
+                double r = pathR[i];
+                double shiftHori = splineHori(r);
+                double shiftVert = splineVert(r);
+
+                PathPoint point;
+                point.x = r * cos(shiftHori * PI / 180);
+                point.y = r * sin(shiftHori * PI / 180);
+                point.z = r * sin(shiftVert * PI / 180);
+                point.pathID = pathID;
+                point.groupID = groupID;
+                pathPoints.push_back(point);
+
+                if (i == pathLength - 1) {
+                  pathEndPoints.push_back(point);
+                }
+              }
+
+              pathID++;
+            }
+          }
+        }
+      }
+
+      groupID++;
+    }
+  }
+
+  pathNum = pathID;
+  groupNum = groupID;
+}
+
+bool writePly(const string& fileName, const vector<PathPoint>& points, const char *properties, int fieldNum)
+{
+  FILE *filePtr = fopen(fileName.c_str(), "w");
+  if (filePtr == NULL) {
+    return false;
+  }
+
+  fprintf(filePtr, "ply\n");
+  fprintf(filePtr, "format ascii 1.0\n");
+  fprintf(filePtr, "element vertex %d\n", int(points.size()));
+  fprintf(filePtr, "%s", properties);
+  fprintf(filePtr, "end_header\n");
+
+  int pointNum = points.size();
+  for (int i = 0; i < pointNum; i++) {
+    if (fieldNum == 4) {
+      fprintf(filePtr, "%f %f %f %d\n", points[i].x, points[i].y, points[i].z, points[i].groupID);
+    } else {
+      fprintf(filePtr, "%f %f %f %d %d\n", points[i].x, points[i].y, points[i].z, points[i].pathID, points[i].groupID);
+    }
+  }
+
+  return fclose(filePtr) == 0;
+}
+
+// uniform grid over the path points, a range query visits the cells whose box is within
+// the search radius of the query point
+struct PointGrid
+{
+  float minX, minY, minZ, cellSize;
+  int cellNumX, cellNumY, cellNumZ;
+  vector<int> cellStart;
+  vector<float> pointX, pointY, pointZ;
+  vector<int> pointPathID;
+
+  int cellIndex(int indX, int indY, int indZ) const
+  {
+    return (indX * cellNumY + indY) * cellNumZ + indZ;
+  }
+
+  void build(const vector<PathPoint>& points, float zScale, float size)
+  {
+    int pointNum = points.size();
+    cellSize = size;
+    minX = minY = minZ = 1e10;
+    float maxX = -1e10, maxY = -1e10, maxZ = -1e10;
+    for (int i = 0; i < pointNum; i++) {
+      float z = zScale * points[i].z;
+      minX = min(minX, points[i].x); maxX = max(maxX, points[i].x);
+      minY = min(minY, points[i].y); maxY = max(maxY, points[i].y);
+      minZ = min(minZ, z); maxZ = max(maxZ, z);
+    }
+
+    cellNumX = int((maxX - minX) / cellSize) + 1;
+    cellNumY = int((maxY - minY) / cellSize) + 1;
+    cellNumZ = int((maxZ - minZ) / cellSize) + 1;
+
+    vector<int> pointCell(pointNum);
+    cellStart.assign(cellNumX * cellNumY * cellNumZ + 1, 0);
+    for (int i = 0; i < pointNum; i++) {
+      int indX = int((points[i].x - minX) / cellSize);
+      int indY = int((points[i].y - minY) / cellSize);
+      int indZ = int((zScale * points[i].z - minZ) / cellSize);
+      pointCell[i] = cellIndex(indX, indY, indZ);
+      cellStart[pointCell[i] + 1]++;
+    }
+    for (size_t i = 1; i < cellStart.size(); i++) {
+      cellStart[i] += cellStart[i - 1];
+    }
+
+    vector<int> cellFill(cellStart.begin(), cellStart.end() - 1);
+    pointX.resize(pointNum);
+    pointY.resize(pointNum);
+    pointZ.resize(pointNum);
+    pointPathID.resize(pointNum);
+    for (int i = 0; i < pointNum; i++) {
+      int ind = cellFill[pointCell[i]]++;
+      pointX[ind] = points[i].x;
+      pointY[ind] = points[i].y;
+      pointZ[ind] = zScale * points[i].z;
+      pointPathID[ind] = points[i].pathID;
+    }
+  }
+};
+
+struct CorrespondenceBatch
+{
+  int voxelStart, voxelEnd;
+  vector<int> voxelPathStart;
+  vector<short> voxelPath;
+};
+
+void findCorrespondences(const PointGrid& grid, CorrespondenceBatch& batch)
+{
+  double searchScale = searchRadiusHori / searchRadiusVert;
+  double radiusSq = searchRadiusHori * searchRadiusHori;
+
+  vector<int> pathVisit(pathNum, -1);
+  vector<short> voxelPaths;
+
+  batch.voxelPathStart.clear();
+  batch.voxelPath.clear();
+  for (int ind = batch.voxelStart; ind < batch.voxelEnd; ind++) {
+    int indX = ind / (voxelNumY * voxelNumZ);
+    int indY = (ind / voxelNumZ) % voxelNumY;
+    int indZ = ind % voxelNumZ;
+
+    double x = offsetX - voxelSize * indX;
+    double scaleY = x / offsetX + searchRadiusHori / offsetY * (offsetX - x) / offsetX;
+    double scaleZ = x / offsetX + searchRadiusVert / offsetZ * (offsetX - x) / offsetX;
+    double y = scaleY * (offsetY - voxelSize * indY);
+    double z = searchScale * (scaleZ * (offsetZ - voxelSize * indZ) + sensorOffset);
+
+    int cellMinX = max(int(floor((x - searchRadiusHori - grid.minX) / grid.cellSize)), 0);
+    int cellMaxX = min(int(floor((x + searchRadiusHori - grid.minX) / grid.cellSize)), grid.cellNumX - 1);
+    int cellMinY = max(int(floor((y - searchRadiusHori - grid.minY) / grid.cellSize)), 0);
+    int cellMaxY = min(int(floor((y + searchRadiusHori - grid.minY) / grid.cellSize)), grid.cellNumY - 1);
+    int cellMinZ = max(int(floor((z - searchRadiusHori - grid.minZ) / grid.cellSize)), 0);
+    int cellMaxZ = min(int(floor((z + searchRadiusHori - grid.minZ) / grid.cellSize)), grid.cellNumZ - 1);
+
+    voxelPaths.clear();
+    for (int cx = cellMinX; cx <= cellMaxX; cx++) {
+      double boxX = grid.minX + cx * grid.cellSize;
+      double gapX = max(max(boxX - x, x - boxX - grid.cellSize), 0.0);
+      for (int cy = cellMinY; cy <= cellMaxY; cy++) {
+        double boxY = grid.minY + cy * grid.cellSize;
+        double gapY = max(max(boxY - y, y - boxY - grid.cellSize), 0.0);
+        if (gapX * gapX + gapY * gapY > radiusSq) continue;
+        for (int cz = cellMinZ; cz <= cellMaxZ; cz++) {
+          double boxZ = grid.minZ + cz * grid.cellSize;
+          double gapZ = max(max(boxZ - z, z - boxZ - grid.cellSize), 0.0);
+          if (gapX * gapX + gapY * gapY + gapZ * gapZ > radiusSq) continue;
+
+          int cell = grid.cellIndex(cx, cy, cz);
+          for (int i = grid.cellStart[cell]; i < grid.cellStart[cell + 1]; i++) {
+            int pathID = grid.pointPathID[i];
+            if (pathVisit[pathID] == ind) continue;
+
+            double dx = grid.pointX[i] - x;
+            double dy = grid.pointY[i] - y;
+            double dz = grid.pointZ[i] - z;
+            if (dx * dx + dy * dy + dz * dz <= radiusSq) {
+              pathVisit[pathID] = ind;
+              voxelPaths.push_back(pathID);
+            }
+          }
+        }
+      }
+    }
+
+    sort(voxelPaths.begin(), voxelPaths.end());
+    batch.voxelPathStart.push_back(batch.voxelPath.size());
+    batch.voxelPath.insert(batch.voxelPath.end(), voxelPaths.begin(), voxelPaths.end());
+  }
+  batch.voxelPathStart.push_back(batch.voxelPath.size());
+}
+
+bool writeCorrespondences(const string& fileName)
+{
+  PointGrid grid;
+  grid.build(pathPoints, searchRadiusHori / searchRadiusVert, searchRadiusHori / 4);
+
+  int voxelNum = voxelNumX * voxelNumY * voxelNumZ;
+  int batchNum = threadNum;
+  if (batchNum <= 0) batchNum = thread::hardware_concurrency();
+  if (batchNum <= 0) batchNum = 1;
+
+  vector<CorrespondenceBatch> batches(batchNum);
+  vector<thread> threads;
+  for (int i = 0; i < batchNum; i++) {
+    batches[i].voxelStart = int((long long)voxelNum * i / batchNum);
+    batches[i].voxelEnd = int((long long)voxelNum * (i + 1) / batchNum);
+    threads.push_back(thread(findCorrespondences, std::cref(grid), std::ref(batches[i])));
+  }
+  for (int i = 0; i < batchNum; i++) {
+    threads[i].join();
+  }
+
+  FILE *filePtr = fopen(fileName.c_str(), "wb");
+  if (filePtr == NULL) {
+    return false;
+  }
+
+  const short endMark = -1;
+  for (int i = 0; i < batchNum; i++) {
+    for (int ind = batches[i].voxelStart; ind < batches[i].voxelEnd; ind++) {
+      int32_t voxelID = ind;
+      int pathStart = batches[i].voxelPathStart[ind - batches[i].voxelStart];
+      int pathEnd = batches[i].voxelPathStart[ind - batches[i].voxelStart + 1];
+
+      fwrite(&voxelID, 4, 1, filePtr);
+      if (pathEnd > pathStart) {
+        fwrite(&batches[i].voxelPath[pathStart], 2, pathEnd - pathStart, filePtr);
+      }
+      fwrite(&endMark, 2, 1, filePtr);
+    }
+  }
+
+  return fclose(filePtr) == 0;
+}
+
+void printUsage()
+{
+  printf ("\nUsage: pathGenerator <outputFolder> [--name value ...]\n\n"
+          "Path set:        --dis --horiAngle --vertAngle --scale\n"
+          "Correspondence:  --voxelSize --searchRadiusHori --searchRadiusVert --sensorOffset\n"
+          "                 --offsetX --offsetY --offsetZ --voxelNumX --voxelNumY --voxelNumZ\n"
+          "Threads:         --threadNum (0 for hardware concurrency)\n\n");
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2 || argc % 2 != 0) {
+    printUsage();
+    return 1;
+  }
+
+  outputFolder = argv[1];
+  for (int i = 2; i < argc; i += 2) {
+    string name = argv[i];
+    const char *value = argv[i + 1];
+
+    if (name == "--dis") dis = atof(value);
+    else if (name == "--horiAngle") horiAngle = atof(value);
+    else if (name == "--vertAngle") vertAngle = atof(value);
+    else if (name == "--scale") scale = atof(value);
+    else if (name == "--voxelSize") voxelSize = atof(value);
+    else if (name == "--searchRadiusHori") searchRadiusHori = atof(value);
+    else if (name == "--searchRadiusVert") searchRadiusVert = atof(value);
+    else if (name == "--sensorOffset") sensorOffset = atof(value);
+    else if (name == "--offsetX") offsetX = atof(value);
+    else if (name == "--offsetY") offsetY = atof(value);
+    else if (name == "--offsetZ") offsetZ = atof(value);
+    else if (name == "--voxelNumX") voxelNumX = atoi(value);
+    else if (name == "--voxelNumY") voxelNumY = atoi(value);
+    else if (name == "--voxelNumZ") voxelNumZ = atoi(value);
+    else if (name == "--threadNum") threadNum = atoi(value);
+    else {
+      printUsage();
+      return 1;
+    }
+  }
+
+  if (dis <= 0 || horiAngle <= 0 || vertAngle <= 0 || scale <= 0 || voxelSize <= 0 || searchRadiusHori <= 0 ||
+      searchRadiusVert <= 0 || voxelNumX <= 0 || voxelNumY <= 0 || voxelNumZ <= 0) {
+    printf ("\nIncorrect parameters, exit.\n\n");
+    return 1;
+  }
+
+  timespec startTime, pathTime, endTime;
+  clock_gettime(CLOCK_MONOTONIC, &startTime);
+
+  printf ("\nGenerating paths\n");
+  generatePaths();
+
+  if (pathNum > 32767) {
+    printf ("\nToo many paths for the correspondence format, exit.\n\n");
+    return 1;
+  }
+
+  if (!writePly(outputFolder + "/startPaths.ply", startPathPoints,
+                "property float x\nproperty float y\nproperty float z\nproperty int group_id\n", 4) ||
+      !writePly(outputFolder + "/paths.ply", pathPoints,
+                "property float x\nproperty float y\nproperty float z\nproperty int path_id\nproperty int group_id\n", 5) ||
+      !writePly(outputFolder + "/pathList.ply", pathEndPoints,
+                "property float end_x\nproperty float end_y\nproperty float end_z\nproperty int path_id\nproperty int group_id\n", 5)) {
+    printf ("\nCannot write path files, exit.\n\n");
+    return 1;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &pathTime);
+  printf ("\n%d paths in %d groups, %.3f s\n", pathNum, groupNum,
+          pathTime.tv_sec - startTime.tv_sec + 1e-9 * (pathTime.tv_nsec - startTime.tv_nsec));
+
+  printf ("\nFinding correspondences\n");
+  if (!writeCorrespondences(outputFolder + "/correspondences.txt")) {
+    printf ("\nCannot write correspondences, exit.\n\n");
+    return 1;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &endTime);
+  printf ("\n%d voxels, %.3f s\n", voxelNumX * voxelNumY * voxelNumZ,
+          endTime.tv_sec - pathTime.tv_sec + 1e-9 * (endTime.tv_nsec - pathTime.tv_nsec));
+
+  printf ("\nProcessing complete\n\n");
+
+  return 0;
+}
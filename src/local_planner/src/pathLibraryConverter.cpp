@@ -0,0 +1,306 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "pathLibrary.h"
+
+using namespace std;
+
+const double PI = 3.1415926;
+
+string pathFolder;
+string outputFile;
+
+int gridVoxelNumX = 33;
+int gridVoxelNumY = 91;
+int gridVoxelNumZ = 34;
+float gridVoxelSize = 0.2;
+float searchRadiusHori = 1.2;
+float searchRadiusVert = 0.8;
+float gridVoxelOffsetX = 6.4;
+float gridVoxelOffsetY = 9.0;
+float gridVoxelOffsetZ = 3.3;
+
+PathLibraryData lib;
+
+void readError()
+{
+  printf ("\nError reading input files, exit.\n\n");
+  exit(1);
+}
+
+FILE *openInputFile(const string& fileName, const char *mode)
+{
+  FILE *filePtr = fopen(fileName.c_str(), mode);
+  if (filePtr == NULL) {
+    printf ("\nCannot read input file %s, exit.\n\n", fileName.c_str());
+    exit(1);
+  }
+
+  return filePtr;
+}
+
+int readPlyHeader(FILE *filePtr)
+{
+  char str[50];
+  int val, pointNum = 0;
+  string strCur, strLast;
+  while (strCur != "end_header") {
+    val = fscanf(filePtr, "%49s", str);
+    if (val != 1) readError();
+
+    strLast = strCur;
+    strCur = string(str);
+
+    if (strCur == "vertex" && strLast == "element") {
+      val = fscanf(filePtr, "%d", &pointNum);
+      if (val != 1) readError();
+    }
+  }
+
+  return pointNum;
+}
+
+void readPathList()
+{
+  FILE *filePtr = openInputFile(pathFolder + "/pathList.ply", "r");
+
+  int pointNum = readPlyHeader(filePtr);
+
+  vector<float> endXList(pointNum), endYList(pointNum), endZList(pointNum);
+  vector<int> pathIDList(pointNum), groupIDList(pointNum);
+  int groupNum = 0;
+  for (int i = 0; i < pointNum; i++) {
+    if (fscanf(filePtr, "%f %f %f %d %d", &endXList[i], &endYList[i], &endZList[i],
+               &pathIDList[i], &groupIDList[i]) != 5) {
+      readError();
+    }
+
+    if (groupIDList[i] + 1 > groupNum) groupNum = groupIDList[i] + 1;
+  }
+
+  fclose(filePtr);
+
+  lib.pathNum = pointNum;
+  lib.groupNum = groupNum;
+  lib.pathGroup.assign(pointNum, 0);
+  lib.endPitch.assign(pointNum, 0);
+  lib.endYaw.assign(pointNum, 0);
+  lib.endZ.assign(pointNum, 0);
+
+  for (int i = 0; i < pointNum; i++) {
+    int pathID = pathIDList[i];
+    int groupID = groupIDList[i];
+    float endX = endXList[i];
+    float endY = endYList[i];
+    float endZ = endZList[i];
+
+    if (pathID >= 0 && pathID < pointNum && groupID >= 0 && groupID < groupNum) {
+      lib.pathGroup[pathID] = groupID;
+      lib.endPitch[pathID] = -atan2(endZ, sqrt(endX * endX + endY * endY)) * 180.0 / PI;
+      lib.endYaw[pathID] = atan2(endY, endX) * 180.0 / PI;
+      lib.endZ[pathID] = endZ;
+    }
+  }
+}
+
+void readStartPaths()
+{
+  FILE *filePtr = openInputFile(pathFolder + "/startPaths.ply", "r");
+
+  int pointNum = readPlyHeader(filePtr);
+
+  vector<vector<float> > pointX(lib.groupNum), pointY(lib.groupNum), pointZ(lib.groupNum);
+  float x, y, z;
+  int groupID;
+  for (int i = 0; i < pointNum; i++) {
+    if (fscanf(filePtr, "%f %f %f %d", &x, &y, &z, &groupID) != 4) {
+      readError();
+    }
+
+    if (groupID >= 0 && groupID < lib.groupNum) {
+      pointX[groupID].push_back(x);
+      pointY[groupID].push_back(y);
+      pointZ[groupID].push_back(z);
+    }
+  }
+
+  fclose(filePtr);
+
+  lib.startPathStart.assign(lib.groupNum + 1, 0);
+  for (int i = 0; i < lib.groupNum; i++) {
+    lib.startPathStart[i] = lib.startPathX.size();
+    lib.startPathX.insert(lib.startPathX.end(), pointX[i].begin(), pointX[i].end());
+    lib.startPathY.insert(lib.startPathY.end(), pointY[i].begin(), pointY[i].end());
+    lib.startPathZ.insert(lib.startPathZ.end(), pointZ[i].begin(), pointZ[i].end());
+  }
+  lib.startPathStart[lib.groupNum] = lib.startPathX.size();
+}
+
+void readPaths()
+{
+  FILE *filePtr = openInputFile(pathFolder + "/paths.ply", "r");
+
+  int pointNum = readPlyHeader(filePtr);
+
+  vector<vector<float> > pointX(lib.pathNum), pointY(lib.pathNum), pointZ(lib.pathNum), pointI(lib.pathNum);
+  int pointSkipNum = 14;
+  int pointSkipCount = 0;
+  float x, y, z, intensity;
+  int pathID;
+  for (int i = 0; i < pointNum; i++) {
+    if (fscanf(filePtr, "%f %f %f %d %f", &x, &y, &z, &pathID, &intensity) != 5) {
+      readError();
+    }
+
+    if (pathID >= 0 && pathID < lib.pathNum) {
+      pointSkipCount++;
+      if (pointSkipCount > pointSkipNum) {
+        pointX[pathID].push_back(x);
+        pointY[pathID].push_back(y);
+        pointZ[pathID].push_back(z);
+        pointI[pathID].push_back(intensity);
+        pointSkipCount = 0;
+      }
+    }
+  }
+
+  fclose(filePtr);
+
+  lib.pathPointStart.assign(lib.pathNum + 1, 0);
+  for (int i = 0; i < lib.pathNum; i++) {
+    lib.pathPointStart[i] = lib.pathPointX.size();
+    lib.pathPointX.insert(lib.pathPointX.end(), pointX[i].begin(), pointX[i].end());
+    lib.pathPointY.insert(lib.pathPointY.end(), pointY[i].begin(), pointY[i].end());
+    lib.pathPointZ.insert(lib.pathPointZ.end(), pointZ[i].begin(), pointZ[i].end());
+    lib.pathPointIntensity.insert(lib.pathPointIntensity.end(), pointI[i].begin(), pointI[i].end());
+  }
+  lib.pathPointStart[lib.pathNum] = lib.pathPointX.size();
+}
+
+void readCorrespondences()
+{
+  FILE *filePtr = openInputFile(pathFolder + "/correspondences.txt", "rb");
+
+  fseek(filePtr, 0, SEEK_END);
+  long fileSize = ftell(filePtr);
+  fseek(filePtr, 0, SEEK_SET);
+
+  vector<char> buffer(fileSize);
+  if (fileSize <= 0 || fread(buffer.data(), 1, fileSize, filePtr) != size_t(fileSize)) {
+    readError();
+  }
+
+  fclose(filePtr);
+
+  int gridVoxelNum = gridVoxelNumX * gridVoxelNumY * gridVoxelNumZ;
+  vector<vector<uint16_t> > voxelPaths(gridVoxelNum);
+
+  long pos = 0;
+  int32_t gridVoxelID;
+  int16_t pathID;
+  for (int i = 0; i < gridVoxelNum; i++) {
+    if (pos + 4 > fileSize) readError();
+    memcpy(&gridVoxelID, &buffer[pos], 4);
+    pos += 4;
+
+    while (1) {
+      if (pos + 2 > fileSize) readError();
+      memcpy(&pathID, &buffer[pos], 2);
+      pos += 2;
+
+      if (pathID == -1) break;
+
+      if (gridVoxelID >= 0 && gridVoxelID < gridVoxelNum && pathID >= 0 && pathID < lib.pathNum) {
+        voxelPaths[gridVoxelID].push_back(pathID);
+      }
+    }
+  }
+
+  lib.correspondenceStart.assign(gridVoxelNum + 1, 0);
+  for (int i = 0; i < gridVoxelNum; i++) {
+    lib.correspondenceStart[i] = lib.correspondence.size();
+    lib.correspondence.insert(lib.correspondence.end(), voxelPaths[i].begin(), voxelPaths[i].end());
+  }
+  lib.correspondenceStart[gridVoxelNum] = lib.correspondence.size();
+}
+
+void printUsage()
+{
+  printf ("\nUsage: pathLibraryConverter <pathFolder> [--output file] [--gridVoxelNumX n] [--gridVoxelNumY n]\n"
+          "         [--gridVoxelNumZ n] [--gridVoxelSize v] [--searchRadiusHori v] [--searchRadiusVert v]\n"
+          "         [--gridVoxelOffsetX v] [--gridVoxelOffsetY v] [--gridVoxelOffsetZ v]\n\n"
+          "Reads startPaths.ply, paths.ply, pathList.ply and correspondences.txt from pathFolder and writes\n"
+          "pathFolder/pathLibrary.bin unless --output is given.\n\n");
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2 || argc % 2 != 0) {
+    printUsage();
+    return 1;
+  }
+
+  pathFolder = argv[1];
+  outputFile = pathFolder + "/pathLibrary.bin";
+
+  for (int i = 2; i < argc; i += 2) {
+    string name = argv[i];
+    const char *value = argv[i + 1];
+
+    if (name == "--output") outputFile = value;
+    else if (name == "--gridVoxelNumX") gridVoxelNumX = atoi(value);
+    else if (name == "--gridVoxelNumY") gridVoxelNumY = atoi(value);
+    else if (name == "--gridVoxelNumZ") gridVoxelNumZ = atoi(value);
+    else if (name == "--gridVoxelSize") gridVoxelSize = atof(value);
+    else if (name == "--searchRadiusHori") searchRadiusHori = atof(value);
+    else if (name == "--searchRadiusVert") searchRadiusVert = atof(value);
+    else if (name == "--gridVoxelOffsetX") gridVoxelOffsetX = atof(value);
+    else if (name == "--gridVoxelOffsetY") gridVoxelOffsetY = atof(value);
+    else if (name == "--gridVoxelOffsetZ") gridVoxelOffsetZ = atof(value);
+    else {
+      printUsage();
+      return 1;
+    }
+  }
+
+  if (gridVoxelNumX <= 0 || gridVoxelNumY <= 0 || gridVoxelNumZ <= 0) {
+    printf ("\nIncorrect grid dimensions, exit.\n\n");
+    return 1;
+  }
+
+  lib.gridVoxelNumX = gridVoxelNumX;
+  lib.gridVoxelNumY = gridVoxelNumY;
+  lib.gridVoxelNumZ = gridVoxelNumZ;
+  lib.gridVoxelSize = gridVoxelSize;
+  lib.searchRadiusHori = searchRadiusHori;
+  lib.searchRadiusVert = searchRadiusVert;
+  lib.gridVoxelOffsetX = gridVoxelOffsetX;
+  lib.gridVoxelOffsetY = gridVoxelOffsetY;
+  lib.gridVoxelOffsetZ = gridVoxelOffsetZ;
+
+  printf ("\nReading path files.\n");
+
+  readPathList();
+  readStartPaths();
+  readPaths();
+  readCorrespondences();
+
+  if (lib.pathNum > 65535) {
+    printf ("\nToo many paths for the library format, exit.\n\n");
+    return 1;
+  }
+
+  if (!writePathLibrary(outputFile.c_str(), lib)) {
+    printf ("\nCannot write %s, exit.\n\n", outputFile.c_str());
+    return 1;
+  }
+
+  printf ("\nWrote %s: %d paths, %d groups, %d correspondences.\n\n", outputFile.c_str(),
+          lib.pathNum, lib.groupNum, int(lib.correspondence.size()));
+
+  return 0;
+}
@@ -0,0 +1,1369 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+
+#include <pcl/filters/voxel_grid.h>
+
+#include "plannerPipeline.h"
+#include "pathLibrary.h"
+#include "workerPool.h"
+#include "rollingOccupancyMap.h"
+#include "voxelStack.h"
+#include "pathScoring.h"
+#include "poseBuffer.h"
+#include "temporalVoxelFilter.h"
+
+using namespace std;
+
+const double PI = 3.1415926;
+
+// pipeline parameters
+string pathFolder;
+bool usePathLibrary = false;
+double depthCloudDelay = 0;
+bool useCloudStamp = false;
+double depthCamPitchOffset = 0;
+double depthCamXOffset = 0;
+double depthCamYOffset = 0;
+double depthCamZOffset = 0;
+double scanVoxelSize = 0.1;
+bool useVoxelHashFilter = true;
+bool temporalFilter = false;
+int temporalFilterFrames = 5;
+int temporalFilterMinHits = 3;
+double temporalFilterPassDis = 0.5;
+bool threadedIngest = false;
+bool eventDrivenPlanning = false;
+bool parallelScaleSearch = false;
+int laserCloudStackNum = 1;
+int laserCloudCount = 0;
+int pointPerPathThre = 2;
+bool bitsetVoting = false;
+bool stockGrid = true;
+double maxRange = 4.0;
+double maxElev = 5.0;
+bool keepSurrCloud = true;
+double keepHoriDis = 1.0;
+double keepVertDis = 0.5;
+int keepDecayFrames = 0;
+int keepMinHits = 1;
+double lowerBoundZ = -1.2;
+double upperBoundZ = 1.2;
+double pitchDiffLimit = 35.0;
+double pitchWeight = 0.03;
+double sensorMaxPitch = 25.0;
+double sensorMaxYaw = 40.0;
+double yawDiffLimit = 60.0;
+double yawWeight = 0.015;
+double pathScale = 0.5;
+double minPathScale = 0.25;
+double pathScaleStep = 0.125;
+bool pathScaleBySpeed = true;
+double stopDis = 0.5;
+double goalX = 0;
+double goalY = 0;
+double goalZ = 1.0;
+
+// path parameters, set according to path files
+int pathNum = 4375;
+int groupNum = 25;
+float gridVoxelSize = 0.2;
+float searchRadiusHori = 1.2;
+float searchRadiusVert = 0.8;
+float gridVoxelOffsetX = 6.4;
+float gridVoxelOffsetY = 9.0;
+float gridVoxelOffsetZ = 3.3;
+int gridVoxelNumX = 33;
+int gridVoxelNumY = 91;
+int gridVoxelNumZ = 34;
+int gridVoxelNum = gridVoxelNumX * gridVoxelNumY * gridVoxelNumZ;
+
+// stock path set dimensions, voxel voting is compiled with these as constants
+const int stockGridVoxelNumX = 33;
+const int stockGridVoxelNumY = 91;
+const int stockGridVoxelNumZ = 34;
+
+float joyFwd = 0;
+float joyLeft = 0;
+float joyUp = 0;
+bool manualMode = true;
+bool autonomyMode = false;
+bool autoAdjustMode = false;
+int systemInitDelay = 5;
+
+float trackX = 0;
+float trackY = 0;
+float trackZ = 0;
+float trackRoll = 0;
+float trackPitch = 0;
+float trackYaw = 0;
+
+const PlannerParam plannerParams[] = {
+  {"pathFolder", 's', &pathFolder},
+  {"usePathLibrary", 'b', &usePathLibrary},
+  {"depthCloudDelay", 'd', &depthCloudDelay},
+  {"useCloudStamp", 'b', &useCloudStamp},
+  {"depthCamPitchOffset", 'd', &depthCamPitchOffset},
+  {"depthCamXOffset", 'd', &depthCamXOffset},
+  {"depthCamYOffset", 'd', &depthCamYOffset},
+  {"depthCamZOffset", 'd', &depthCamZOffset},
+  {"scanVoxelSize", 'd', &scanVoxelSize},
+  {"useVoxelHashFilter", 'b', &useVoxelHashFilter},
+  {"temporalFilter", 'b', &temporalFilter},
+  {"temporalFilterFrames", 'i', &temporalFilterFrames},
+  {"temporalFilterMinHits", 'i', &temporalFilterMinHits},
+  {"temporalFilterPassDis", 'd', &temporalFilterPassDis},
+  {"parallelScaleSearch", 'b', &parallelScaleSearch},
+  {"laserCloudStackNum", 'i', &laserCloudStackNum},
+  {"pointPerPathThre", 'i', &pointPerPathThre},
+  {"bitsetVoting", 'b', &bitsetVoting},
+  {"maxRange", 'd', &maxRange},
+  {"maxElev", 'd', &maxElev},
+  {"keepSurrCloud", 'b', &keepSurrCloud},
+  {"keepHoriDis", 'd', &keepHoriDis},
+  {"keepVertDis", 'd', &keepVertDis},
+  {"keepDecayFrames", 'i', &keepDecayFrames},
+  {"keepMinHits", 'i', &keepMinHits},
+  {"lowerBoundZ", 'd', &lowerBoundZ},
+  {"upperBoundZ", 'd', &upperBoundZ},
+  {"pitchDiffLimit", 'd', &pitchDiffLimit},
+  {"pitchWeight", 'd', &pitchWeight},
+  {"sensorMaxPitch", 'd', &sensorMaxPitch},
+  {"sensorMaxYaw", 'd', &sensorMaxYaw},
+  {"yawDiffLimit", 'd', &yawDiffLimit},
+  {"yawWeight", 'd', &yawWeight},
+  {"pathScale", 'd', &pathScale},
+  {"minPathScale", 'd', &minPathScale},
+  {"pathScaleStep", 'd', &pathScaleStep},
+  {"pathScaleBySpeed", 'b', &pathScaleBySpeed},
+  {"stopDis", 'd', &stopDis},
+  {"gridVoxelSize", 'f', &gridVoxelSize},
+  {"searchRadiusHori", 'f', &searchRadiusHori},
+  {"searchRadiusVert", 'f', &searchRadiusVert},
+  {"gridVoxelOffsetX", 'f', &gridVoxelOffsetX},
+  {"gridVoxelOffsetY", 'f', &gridVoxelOffsetY},
+  {"gridVoxelOffsetZ", 'f', &gridVoxelOffsetZ},
+  {"gridVoxelNumX", 'i', &gridVoxelNumX},
+  {"gridVoxelNumY", 'i', &gridVoxelNumY},
+  {"gridVoxelNumZ", 'i', &gridVoxelNumZ}
+};
+
+const int plannerParamNum = sizeof(plannerParams) / sizeof(plannerParams[0]);
+
+pcl::PointCloud<pcl::PointXYZ>::Ptr laserCloudCrop(new pcl::PointCloud<pcl::PointXYZ>());
+pcl::PointCloud<pcl::PointXYZ>::Ptr laserCloudDwz(new pcl::PointCloud<pcl::PointXYZ>());
+std::vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> laserCloudStack;
+pcl::PointCloud<pcl::PointXYZ>::Ptr plannerCloudStack(new pcl::PointCloud<pcl::PointXYZ>());
+pcl::PointCloud<pcl::PointXYZ>::Ptr plannerCloud;
+
+bool recordScanInput = false;
+std::vector<float> scanInputPoints;
+PlannerRecorder plannerRecorder;
+std::mutex plannerRecordMutex;
+
+// path tables, pointing either into the mapped path library or into pathLibData
+// when read from the PLY files, startPaths, paths and correspondences are CSR arrays
+PathLibraryData pathLibData;
+const int *pathList = NULL;
+const float *endPitchPathList = NULL;
+const float *endYawPathList = NULL;
+const float *endZPathList = NULL;
+const int *startPathStart = NULL;
+const float *startPathX = NULL;
+const float *startPathY = NULL;
+const float *startPathZ = NULL;
+const int *pathPointStart = NULL;
+const float *pathPointX = NULL;
+const float *pathPointY = NULL;
+const float *pathPointZ = NULL;
+const float *pathPointIntensity = NULL;
+const int *correspondenceStart = NULL;
+const unsigned short *correspondences = NULL;
+
+// paths are ordered by group at load time, group i holds the path IDs
+// groupPathStart[i] to groupPathStart[i + 1] - 1, pathSourceID maps them back to the file IDs
+std::vector<int> groupPathStart;
+std::vector<int> pathSourceID;
+
+bool pathPointsLoaded = false;
+bool pathPointsFailed = false;
+
+// bitset collision voting, each voxel stores its blocked paths as sparse 64-bit words
+// and the per-path point count is kept as bit-sliced counters saturating at pointPerPathThre
+const int maxCountPlaneNum = 31;
+int pathWordNum = 0;
+std::vector<int> correspondenceWordStart;
+std::vector<unsigned short> correspondenceWordID;
+std::vector<uint64_t> correspondenceWordMask;
+int countPlaneNum = 0;
+
+std::vector<PathSearch> pathSearches;
+WorkerPool scaleWorkerPool;
+
+float relativeGoalX = 0;
+float relativeGoalDis = 0;
+float relativeGoalPitch = 0;
+float relativeGoalYaw = 0;
+
+// FOV penalty and goal direction score per path, computed once per frame for all scales
+std::vector<int> pathFovPenalty;
+std::vector<double> pathGoalScore;
+
+const char *plannerStageNames[plannerStageNum] = {
+  "scan_input", "scan_downsample", "scan_transform", "temporal_filter", "keep_cloud", "cloud_stack", "scan_total",
+  "cloud_to_track", "frame_scoring", "path_voting", "group_scoring", "scale_search", "path_extraction",
+  "planning_total", "scan_to_path", "visualization"
+};
+
+StageProfiler stageProfiler;
+
+double laserTime = 0;
+
+LatestFrameSlot<PlannerFrame> plannerFrameSlot;
+std::mutex plannerFrameMutex;
+std::condition_variable plannerFrameCond;
+double plannerCloudTime = 0;
+double plannerCloudStamp = 0;
+float plannerVehiclePitch = 0;
+float plannerVehicleYaw = 0;
+bool plannerCloudCameraFrame = false;
+float plannerCameraToWorld[12] = {0};
+
+std::atomic<bool> clearSurrCloudRequest(false);
+
+// odometry written by the odometry handler, the scan is transformed with the pose interpolated
+// at laserTime
+PoseBuffer odomBuffer(400);
+PoseSample laserPose;
+
+pcl::VoxelGrid<pcl::PointXYZ> downSizeFilter;
+VoxelHashFilter scanHashFilter;
+TemporalVoxelFilter scanTemporalFilter;
+VoxelStack plannerVoxelStack;
+RollingOccupancyMap surrOccupancyMap;
+
+bool setPlannerParam(const string& name, const string& value)
+{
+  for (int i = 0; i < plannerParamNum; i++) {
+    const PlannerParam& param = plannerParams[i];
+    if (name != param.name) continue;
+
+    if (param.type == 's') *(string *)param.value = value;
+    else if (param.type == 'b') *(bool *)param.value = value == "true" || value == "1";
+    else if (param.type == 'i') *(int *)param.value = atoi(value.c_str());
+    else if (param.type == 'f') *(float *)param.value = atof(value.c_str());
+    else *(double *)param.value = atof(value.c_str());
+    return true;
+  }
+
+  return false;
+}
+
+string getPlannerParam(const PlannerParam& param)
+{
+  char str[32];
+  if (param.type == 's') return *(const string *)param.value;
+  else if (param.type == 'b') return *(const bool *)param.value ? "true" : "false";
+  else if (param.type == 'i') snprintf(str, sizeof(str), "%d", *(const int *)param.value);
+  else if (param.type == 'f') snprintf(str, sizeof(str), "%.9g", *(const float *)param.value);
+  else snprintf(str, sizeof(str), "%.17g", *(const double *)param.value);
+  return str;
+}
+
+void addOdometry(double time, float roll, float pitch, float yaw, float x, float y, float z)
+{
+  odomBuffer.push(time, roll, pitch, yaw, x, y, z);
+}
+
+void clearLaserFrame()
+{
+  if (useVoxelHashFilter) {
+    scanHashFilter.clear();
+  } else {
+    laserCloudCrop->clear();
+  }
+}
+
+bool startLaserFrame(double scanStamp)
+{
+  if (systemInitDelay > 0) {
+    systemInitDelay--;
+    return false;
+  }
+
+  int64_t odomNewest = odomBuffer.newest();
+  double odomNewestTime;
+  if (odomNewest < odomBuffer.oldest() || !odomBuffer.read(odomNewest, odomNewestTime)) {
+    return false;
+  }
+
+  if (useCloudStamp) {
+    laserTime = scanStamp - depthCloudDelay;
+  } else {
+    laserTime = odomNewestTime - depthCloudDelay;
+  }
+  odomBuffer.interpolate(laserTime, laserPose);
+
+  clearLaserFrame();
+  return true;
+}
+
+void startRecordedLaserFrame(const ScanRecord& scan)
+{
+  laserTime = scan.laserTime;
+  setPoseRotation(laserPose, scan.roll, scan.pitch, scan.yaw);
+  laserPose.x = scan.x;
+  laserPose.y = scan.y;
+  laserPose.z = scan.z;
+
+  clearLaserFrame();
+}
+
+// applies a row-major 3x4 transform in place
+void transformCloud(pcl::PointCloud<pcl::PointXYZ>& cloud, const float *transform)
+{
+  int cloudSize = cloud.points.size();
+  pcl::PointXYZ *points = cloud.points.data();
+  for (int i = 0; i < cloudSize; i++) {
+    float x = points[i].x;
+    float y = points[i].y;
+    float z = points[i].z;
+    points[i].x = transform[0] * x + transform[1] * y + transform[2] * z + transform[3];
+    points[i].y = transform[4] * x + transform[5] * y + transform[6] * z + transform[7];
+    points[i].z = transform[8] * x + transform[9] * y + transform[10] * z + transform[11];
+  }
+}
+
+// rotation and translation from the depth camera frame to the world frame at the vehicle pose
+void getDepthCamToWorld(const PoseSample& pose, double *rotation, double *translation)
+{
+  double sinCamPitch = sin(depthCamPitchOffset), cosCamPitch = cos(depthCamPitchOffset);
+  double camRotation[9] = {0, -sinCamPitch, cosCamPitch, -1.0, 0, 0, 0, -cosCamPitch, -sinCamPitch};
+
+  double sr = sin(pose.roll), cr = cos(pose.roll);
+  double sp = sin(pose.pitch), cp = cos(pose.pitch);
+  double sy = sin(pose.yaw), cy = cos(pose.yaw);
+  double vehicleRotation[9] = {cy * cp, cy * sp * sr - sy * cr, cy * sp * cr + sy * sr,
+                               sy * cp, sy * sp * sr + cy * cr, sy * sp * cr - cy * sr,
+                               -sp, cp * sr, cp * cr};
+  double camOffset[3] = {depthCamXOffset, depthCamYOffset, depthCamZOffset};
+  double vehiclePosition[3] = {pose.x, pose.y, pose.z};
+
+  for (int i = 0; i < 3; i++) {
+    translation[i] = vehiclePosition[i];
+    for (int j = 0; j < 3; j++) {
+      rotation[3 * i + j] = 0;
+      for (int k = 0; k < 3; k++) {
+        rotation[3 * i + j] += vehicleRotation[3 * i + k] * camRotation[3 * k + j];
+      }
+      translation[i] += vehicleRotation[3 * i + j] * camOffset[j];
+    }
+  }
+}
+
+bool getScanDeskewTransform(double timeOffset, float *transform)
+{
+  PoseSample pose;
+  if (!odomBuffer.interpolate(laserTime + timeOffset, pose)) {
+    return false;
+  }
+
+  double scanRotation[9], scanTranslation[3], rotation[9], translation[3];
+  getDepthCamToWorld(laserPose, scanRotation, scanTranslation);
+  getDepthCamToWorld(pose, rotation, translation);
+
+  for (int i = 0; i < 3; i++) {
+    double offset = 0;
+    for (int j = 0; j < 3; j++) {
+      double value = 0;
+      for (int k = 0; k < 3; k++) {
+        value += scanRotation[3 * k + i] * rotation[3 * k + j];
+      }
+      transform[4 * i + j] = value;
+      offset += scanRotation[3 * j + i] * (translation[j] - scanTranslation[j]);
+    }
+    transform[4 * i + 3] = offset;
+  }
+
+  return true;
+}
+
+void publishLaserFrame(PlannerFrame& frame, double scanStamp)
+{
+  frame.time = laserTime;
+  frame.stamp = scanStamp;
+  frame.vehiclePitch = laserPose.pitch;
+  frame.vehicleYaw = laserPose.yaw;
+
+  if (recordScanInput) {
+    ScanRecord record = {scanStamp, laserTime, laserPose.roll, laserPose.pitch, laserPose.yaw,
+                         laserPose.x, laserPose.y, laserPose.z, uint32_t(scanInputPoints.size() / 3), 0};
+    std::lock_guard<std::mutex> lock(plannerRecordMutex);
+    plannerRecorder.write(recordScan, &record, sizeof(record), scanInputPoints.data(),
+                          sizeof(float) * scanInputPoints.size());
+    scanInputPoints.clear();
+    plannerFrameSlot.publish();
+  } else {
+    plannerFrameSlot.publish();
+  }
+
+  if (eventDrivenPlanning && threadedIngest) {
+    { std::lock_guard<std::mutex> lock(plannerFrameMutex); }
+    plannerFrameCond.notify_one();
+  }
+}
+
+void finishLaserFrame(double scanStamp)
+{
+  // the camera to world transform is composed once per frame and applied in a single pass, and
+  // with no cloud kept or stacked in the world frame the scan is not moved to the world frame at
+  // all, planPaths() then takes it from the camera frame to the track point frame directly
+  float cameraToWorld[12];
+  double rotation[9], translation[3];
+  getDepthCamToWorld(laserPose, rotation, translation);
+  for (int i = 0; i < 3; i++) {
+    cameraToWorld[4 * i] = rotation[3 * i];
+    cameraToWorld[4 * i + 1] = rotation[3 * i + 1];
+    cameraToWorld[4 * i + 2] = rotation[3 * i + 2];
+    cameraToWorld[4 * i + 3] = translation[i];
+  }
+  bool worldCloudNeeded = keepSurrCloud || laserCloudStackNum > 1;
+
+  float vehicleX = laserPose.x;
+  float vehicleY = laserPose.y;
+  float vehicleZ = laserPose.z;
+
+  ScopedStageTimer downsampleTimer(stageProfiler, stageScanDownsample);
+  int laserCloudDwzSize = 0;
+  if (useVoxelHashFilter) {
+    scanHashFilter.getCloud(*laserCloudDwz);
+    laserCloudDwzSize = laserCloudDwz->points.size();
+  } else {
+    laserCloudDwz->clear();
+    downSizeFilter.setInputCloud(laserCloudCrop);
+    downSizeFilter.filter(*laserCloudDwz);
+    laserCloudDwzSize = laserCloudDwz->points.size();
+  }
+  downsampleTimer.stop();
+
+  // voxels not seen in enough recent frames are dropped before the scan is kept or stacked
+  if (temporalFilter) {
+    ScopedStageTimer temporalTimer(stageProfiler, stageTemporalFilter);
+    scanTemporalFilter.filter(*laserCloudDwz, cameraToWorld, vehicleX, vehicleY, vehicleZ);
+    laserCloudDwzSize = laserCloudDwz->points.size();
+  }
+
+  if (!worldCloudNeeded) {
+    clearSurrCloudRequest = false;
+
+    PlannerFrame& frame = plannerFrameSlot.writeBuffer();
+    frame.cloud->points.swap(laserCloudDwz->points);
+    frame.cloud->width = laserCloudDwzSize;
+    frame.cloud->height = 1;
+    frame.cameraFrame = true;
+    memcpy(frame.cameraToWorld, cameraToWorld, sizeof(cameraToWorld));
+    publishLaserFrame(frame, scanStamp);
+    return;
+  }
+
+  ScopedStageTimer transformTimer(stageProfiler, stageScanTransform);
+  transformCloud(*laserCloudDwz, cameraToWorld);
+  transformTimer.stop();
+
+  ScopedStageTimer keepTimer(stageProfiler, stageKeepCloud);
+  if (clearSurrCloudRequest.exchange(false)) {
+    surrOccupancyMap.clear();
+  }
+
+  // cells kept from earlier frames are added first, then the current scan is inserted
+  if (keepSurrCloud) {
+    surrOccupancyMap.nextFrame();
+    surrOccupancyMap.moveTo(vehicleX, vehicleY, vehicleZ);
+    surrOccupancyMap.appendOccupied(*laserCloudDwz, vehicleX, vehicleY, vehicleZ, keepHoriDis, keepVertDis);
+
+    for (int i = 0; i < laserCloudDwzSize; i++) {
+      float disX = laserCloudDwz->points[i].x - vehicleX;
+      float disY = laserCloudDwz->points[i].y - vehicleY;
+      float disZ = laserCloudDwz->points[i].z - vehicleZ;
+
+      if (sqrt(disX * disX + disY * disY) < keepHoriDis && fabs(disZ) < keepVertDis) {
+        surrOccupancyMap.insert(laserCloudDwz->points[i].x, laserCloudDwz->points[i].y, laserCloudDwz->points[i].z);
+      }
+    }
+  }
+
+  keepTimer.stop();
+
+  // the voxel stack adds this frame and evicts the oldest one, only VoxelGrid rebuilds the union
+  ScopedStageTimer stackTimer(stageProfiler, stageCloudStack);
+  PlannerFrame& frame = plannerFrameSlot.writeBuffer();
+  if (useVoxelHashFilter) {
+    plannerVoxelStack.addFrame(*laserCloudDwz);
+    plannerVoxelStack.getCloud(*frame.cloud);
+  } else {
+    laserCloudStack[laserCloudCount]->clear();
+    *laserCloudStack[laserCloudCount] = *laserCloudDwz;
+    laserCloudCount = (laserCloudCount + 1) % laserCloudStackNum;
+
+    plannerCloudStack->clear();
+    for (int i = 0; i < laserCloudStackNum; i++) {
+      *plannerCloudStack += *laserCloudStack[i];
+    }
+
+    frame.cloud->clear();
+    downSizeFilter.setInputCloud(plannerCloudStack);
+    downSizeFilter.filter(*frame.cloud);
+  }
+  stackTimer.stop();
+
+  frame.cameraFrame = false;
+  publishLaserFrame(frame, scanStamp);
+}
+
+int readPlyHeader(FILE *filePtr)
+{
+  char str[50];
+  int val, pointNum;
+  string strCur, strLast;
+  while (strCur != "end_header") {
+    val = fscanf(filePtr, "%s", str);
+    if (val != 1) {
+      printf ("\nError reading input files, exit.\n\n");
+      exit(1);
+    }
+
+    strLast = strCur;
+    strCur = string(str);
+
+    if (strCur == "vertex" && strLast == "element") {
+      val = fscanf(filePtr, "%d", &pointNum);
+      if (val != 1) {
+        printf ("\nError reading input files, exit.\n\n");
+        exit(1);
+      }
+    }
+  }
+
+  return pointNum;
+}
+
+void readStartPaths()
+{
+  string fileName = pathFolder + "/startPaths.ply";
+
+  FILE *filePtr = fopen(fileName.c_str(), "r");
+  if (filePtr == NULL) {
+    printf ("\nCannot read input files, exit.\n\n");
+    exit(1);
+  }
+
+  int pointNum = readPlyHeader(filePtr);
+
+  std::vector<std::vector<pcl::PointXYZ> > startPaths(groupNum);
+  pcl::PointXYZ point;
+  int val1, val2, val3, val4, groupID;
+  for (int i = 0; i < pointNum; i++) {
+    val1 = fscanf(filePtr, "%f", &point.x);
+    val2 = fscanf(filePtr, "%f", &point.y);
+    val3 = fscanf(filePtr, "%f", &point.z);
+    val4 = fscanf(filePtr, "%d", &groupID);
+
+    if (val1 != 1 || val2 != 1 || val3 != 1 || val4 != 1) {
+      printf ("\nError reading input files, exit.\n\n");
+        exit(1);
+    }
+
+    if (groupID >= 0 && groupID < groupNum) {
+      startPaths[groupID].push_back(point);
+    }
+  }
+
+  fclose(filePtr);
+
+  pathLibData.startPathStart.assign(groupNum + 1, 0);
+  for (int i = 0; i < groupNum; i++) {
+    pathLibData.startPathStart[i] = pathLibData.startPathX.size();
+    int startPathLength = startPaths[i].size();
+    for (int j = 0; j < startPathLength; j++) {
+      pathLibData.startPathX.push_back(startPaths[i][j].x);
+      pathLibData.startPathY.push_back(startPaths[i][j].y);
+      pathLibData.startPathZ.push_back(startPaths[i][j].z);
+    }
+  }
+  pathLibData.startPathStart[groupNum] = pathLibData.startPathX.size();
+}
+
+bool readPaths()
+{
+  string fileName = pathFolder + "/paths.ply";
+
+  FILE *filePtr = fopen(fileName.c_str(), "r");
+  if (filePtr == NULL) {
+    printf ("\nCannot read %s.\n", fileName.c_str());
+    return false;
+  }
+
+  int pointNum = readPlyHeader(filePtr);
+
+  std::vector<std::vector<pcl::PointXYZI> > paths(pathNum);
+  pcl::PointXYZI point;
+  int pointSkipNum = 14;
+  int pointSkipCount = 0;
+  int val1, val2, val3, val4, val5, pathID;
+  for (int i = 0; i < pointNum; i++) {
+    val1 = fscanf(filePtr, "%f", &point.x);
+    val2 = fscanf(filePtr, "%f", &point.y);
+    val3 = fscanf(filePtr, "%f", &point.z);
+    val4 = fscanf(filePtr, "%d", &pathID);
+    val5 = fscanf(filePtr, "%f", &point.intensity);
+
+    if (val1 != 1 || val2 != 1 || val3 != 1 || val4 != 1 || val5 != 1) {
+      printf ("\nError reading %s.\n", fileName.c_str());
+      fclose(filePtr);
+      return false;
+    }
+
+    if (pathID >= 0 && pathID < pathNum) {
+      pointSkipCount++;
+      if (pointSkipCount > pointSkipNum) {
+        paths[pathID].push_back(point);
+        pointSkipCount = 0;
+      }
+    }
+  }
+
+  fclose(filePtr);
+
+  pathLibData.pathPointStart.assign(pathNum + 1, 0);
+  for (int i = 0; i < pathNum; i++) {
+    pathLibData.pathPointStart[i] = pathLibData.pathPointX.size();
+    const std::vector<pcl::PointXYZI>& path = paths[pathSourceID[i]];
+    int pathLength = path.size();
+    for (int j = 0; j < pathLength; j++) {
+      pathLibData.pathPointX.push_back(path[j].x);
+      pathLibData.pathPointY.push_back(path[j].y);
+      pathLibData.pathPointZ.push_back(path[j].z);
+      pathLibData.pathPointIntensity.push_back(path[j].intensity);
+    }
+  }
+  pathLibData.pathPointStart[pathNum] = pathLibData.pathPointX.size();
+
+  pathPointStart = pathLibData.pathPointStart.data();
+  pathPointX = pathLibData.pathPointX.data();
+  pathPointY = pathLibData.pathPointY.data();
+  pathPointZ = pathLibData.pathPointZ.data();
+  pathPointIntensity = pathLibData.pathPointIntensity.data();
+
+  return true;
+}
+
+void readPathList()
+{
+  string fileName = pathFolder + "/pathList.ply";
+
+  FILE *filePtr = fopen(fileName.c_str(), "r");
+  if (filePtr == NULL) {
+    printf ("\nCannot read input files, exit.\n\n");
+    exit(1);
+  }
+
+  pathNum = readPlyHeader(filePtr);
+  if (pathNum <= 0 || pathNum > 32767) {
+    printf ("\nIncorrect path number, exit.\n\n");
+    exit(1);
+  }
+
+  std::vector<float> endXList(pathNum), endYList(pathNum), endZList(pathNum);
+  std::vector<int> pathIDList(pathNum), groupIDList(pathNum);
+  int val1, val2, val3, val4, val5;
+  groupNum = 0;
+  for (int i = 0; i < pathNum; i++) {
+    val1 = fscanf(filePtr, "%f", &endXList[i]);
+    val2 = fscanf(filePtr, "%f", &endYList[i]);
+    val3 = fscanf(filePtr, "%f", &endZList[i]);
+    val4 = fscanf(filePtr, "%d", &pathIDList[i]);
+    val5 = fscanf(filePtr, "%d", &groupIDList[i]);
+
+    if (val1 != 1 || val2 != 1 || val3 != 1 || val4 != 1 || val5 != 1) {
+      printf ("\nError reading input files, exit.\n\n");
+        exit(1);
+    }
+
+    if (groupNum < groupIDList[i] + 1) groupNum = groupIDList[i] + 1;
+  }
+
+  pathLibData.pathGroup.assign(pathNum, 0);
+  pathLibData.endPitch.assign(pathNum, 0);
+  pathLibData.endYaw.assign(pathNum, 0);
+  pathLibData.endZ.assign(pathNum, 0);
+
+  for (int i = 0; i < pathNum; i++) {
+    float endX = endXList[i];
+    float endY = endYList[i];
+    float endZ = endZList[i];
+    int pathID = pathIDList[i];
+    int groupID = groupIDList[i];
+
+    if (pathID >= 0 && pathID < pathNum && groupID >= 0 && groupID < groupNum) {
+      pathLibData.pathGroup[pathID] = groupID;
+      pathLibData.endPitch[pathID] = -atan2(endZ, sqrt(endX * endX + endY * endY)) * 180.0 / PI;
+      pathLibData.endYaw[pathID] = atan2(endY, endX) * 180.0 / PI;
+      pathLibData.endZ[pathID] = endZ;
+    }
+  }
+
+  fclose(filePtr);
+}
+
+void readCorrespondences()
+{
+  string fileName = pathFolder + "/correspondences.txt";
+
+  FILE *filePtr = fopen(fileName.c_str(), "rb");
+  if (filePtr == NULL) {
+    printf ("\nCannot read input files, exit.\n\n");
+    exit(1);
+  }
+
+  std::vector<int> correspondenceVoxelID;
+  std::vector<unsigned short> correspondencePathID;
+  short pathID;
+  int val1, gridVoxelID;
+  for (int i = 0; i < gridVoxelNum; i++) {
+    val1 = fread(&gridVoxelID, 4, 1, filePtr);
+    if (val1 != 1) {
+      printf ("\nError reading input files, exit.\n\n");
+        exit(1);
+    }
+
+    while (1) {
+      val1 = fread(&pathID, 2, 1, filePtr);
+      if (val1 != 1) {
+        printf ("\nError reading input files, exit.\n\n");
+          exit(1);
+      }
+
+      if (pathID != -1) {
+        if (gridVoxelID >= 0 && gridVoxelID < gridVoxelNum && pathID >= 0 && pathID < pathNum) {
+          correspondenceVoxelID.push_back(gridVoxelID);
+          correspondencePathID.push_back(pathID);
+        }
+      } else {
+        break;
+      }
+    }
+  }
+
+  fclose(filePtr);
+
+  int correspondenceNum = correspondencePathID.size();
+  pathLibData.correspondenceStart.assign(gridVoxelNum + 1, 0);
+  for (int i = 0; i < correspondenceNum; i++) {
+    pathLibData.correspondenceStart[correspondenceVoxelID[i] + 1]++;
+  }
+  for (int i = 0; i < gridVoxelNum; i++) {
+    pathLibData.correspondenceStart[i + 1] += pathLibData.correspondenceStart[i];
+  }
+
+  std::vector<int> correspondenceFill(pathLibData.correspondenceStart.begin(), pathLibData.correspondenceStart.end() - 1);
+  pathLibData.correspondence.resize(correspondenceNum);
+  for (int i = 0; i < correspondenceNum; i++) {
+    pathLibData.correspondence[correspondenceFill[correspondenceVoxelID[i]]++] = correspondencePathID[i];
+  }
+}
+
+void setPathTables()
+{
+  pathList = pathLibData.pathGroup.data();
+  endPitchPathList = pathLibData.endPitch.data();
+  endYawPathList = pathLibData.endYaw.data();
+  endZPathList = pathLibData.endZ.data();
+  startPathStart = pathLibData.startPathStart.data();
+  startPathX = pathLibData.startPathX.data();
+  startPathY = pathLibData.startPathY.data();
+  startPathZ = pathLibData.startPathZ.data();
+  pathPointStart = pathLibData.pathPointStart.data();
+  pathPointX = pathLibData.pathPointX.data();
+  pathPointY = pathLibData.pathPointY.data();
+  pathPointZ = pathLibData.pathPointZ.data();
+  pathPointIntensity = pathLibData.pathPointIntensity.data();
+  correspondenceStart = pathLibData.correspondenceStart.data();
+  correspondences = pathLibData.correspondence.data();
+}
+
+bool checkPathLibraryStarts(const int *starts, int num, int entryNum)
+{
+  if (starts[0] != 0 || starts[num] != entryNum) return false;
+  for (int i = 0; i < num; i++) {
+    if (starts[i] > starts[i + 1]) return false;
+  }
+  return true;
+}
+
+bool readPathLibrary()
+{
+  string fileName = pathFolder + "/pathLibrary.bin";
+
+  int fileDesc = open(fileName.c_str(), O_RDONLY);
+  if (fileDesc < 0) {
+    return false;
+  }
+
+  struct stat fileStat;
+  if (fstat(fileDesc, &fileStat) != 0 || fileStat.st_size < (off_t)sizeof(PathLibraryHeader)) {
+    close(fileDesc);
+    return false;
+  }
+
+  void *fileData = mmap(NULL, fileStat.st_size, PROT_READ, MAP_PRIVATE, fileDesc, 0);
+  close(fileDesc);
+  if (fileData == MAP_FAILED) {
+    return false;
+  }
+
+  const char *lib = (const char *)fileData;
+  const PathLibraryHeader *header = (const PathLibraryHeader *)lib;
+  if (!checkPathLibraryHeader(*header, fileStat.st_size)) {
+    printf ("\nIncorrect path library %s.\n", fileName.c_str());
+    munmap(fileData, fileStat.st_size);
+    return false;
+  }
+
+  pathNum = header->pathNum;
+  groupNum = header->groupNum;
+  gridVoxelNumX = header->gridVoxelNumX;
+  gridVoxelNumY = header->gridVoxelNumY;
+  gridVoxelNumZ = header->gridVoxelNumZ;
+  gridVoxelNum = gridVoxelNumX * gridVoxelNumY * gridVoxelNumZ;
+
+  pathList = (const int *)(lib + header->pathGroupOffset);
+  endPitchPathList = (const float *)(lib + header->endPitchOffset);
+  endYawPathList = (const float *)(lib + header->endYawOffset);
+  endZPathList = (const float *)(lib + header->endZOffset);
+  startPathStart = (const int *)(lib + header->startPathStartOffset);
+  startPathX = (const float *)(lib + header->startPathXOffset);
+  startPathY = (const float *)(lib + header->startPathYOffset);
+  startPathZ = (const float *)(lib + header->startPathZOffset);
+  pathPointStart = (const int *)(lib + header->pathPointStartOffset);
+  pathPointX = (const float *)(lib + header->pathPointXOffset);
+  pathPointY = (const float *)(lib + header->pathPointYOffset);
+  pathPointZ = (const float *)(lib + header->pathPointZOffset);
+  pathPointIntensity = (const float *)(lib + header->pathPointIntensityOffset);
+  correspondenceStart = (const int *)(lib + header->correspondenceStartOffset);
+  correspondences = (const unsigned short *)(lib + header->correspondenceOffset);
+
+  bool valid = checkPathLibraryStarts(startPathStart, groupNum, header->startPathPointNum) &&
+               checkPathLibraryStarts(pathPointStart, pathNum, header->pathPointNum) &&
+               checkPathLibraryStarts(correspondenceStart, gridVoxelNum, header->correspondenceNum);
+  for (int i = 0; valid && i < pathNum; i++) {
+    if (pathList[i] < 0 || pathList[i] >= groupNum) valid = false;
+  }
+  for (int i = 0; valid && i < header->correspondenceNum; i++) {
+    if (correspondences[i] >= pathNum) valid = false;
+  }
+
+  if (!valid) {
+    printf ("\nIncorrect path library %s.\n", fileName.c_str());
+    munmap(fileData, fileStat.st_size);
+    return false;
+  }
+
+  gridVoxelSize = header->gridVoxelSize;
+  searchRadiusHori = header->searchRadiusHori;
+  searchRadiusVert = header->searchRadiusVert;
+  gridVoxelOffsetX = header->gridVoxelOffsetX;
+  gridVoxelOffsetY = header->gridVoxelOffsetY;
+  gridVoxelOffsetZ = header->gridVoxelOffsetZ;
+
+  return true;
+}
+
+// stable reorder of the paths by group with the path IDs in correspondences remapped, tables
+// mapped from the path library are copied only if the library is not in group order already,
+// path points read later from paths.ply are put in this order by readPaths()
+void sortPathsByGroup()
+{
+  groupPathStart.assign(groupNum + 1, 0);
+  for (int i = 0; i < pathNum; i++) {
+    groupPathStart[pathList[i] + 1]++;
+  }
+  for (int i = 0; i < groupNum; i++) {
+    groupPathStart[i + 1] += groupPathStart[i];
+  }
+
+  bool sorted = true;
+  for (int i = 1; i < pathNum; i++) {
+    if (pathList[i] < pathList[i - 1]) {
+      sorted = false;
+      break;
+    }
+  }
+
+  pathSourceID.resize(pathNum);
+  if (sorted) {
+    for (int i = 0; i < pathNum; i++) {
+      pathSourceID[i] = i;
+    }
+    return;
+  }
+
+  printf ("\nPaths not in group order, reordering.\n");
+
+  std::vector<int> newPathID(pathNum);
+  std::vector<int> groupFill(groupPathStart.begin(), groupPathStart.end() - 1);
+  for (int i = 0; i < pathNum; i++) {
+    newPathID[i] = groupFill[pathList[i]]++;
+    pathSourceID[newPathID[i]] = i;
+  }
+
+  std::vector<int32_t> pathGroup(pathNum);
+  std::vector<float> endPitch(pathNum), endYaw(pathNum), endZ(pathNum);
+  for (int i = 0; i < pathNum; i++) {
+    int pathID = newPathID[i];
+    pathGroup[pathID] = pathList[i];
+    endPitch[pathID] = endPitchPathList[i];
+    endYaw[pathID] = endYawPathList[i];
+    endZ[pathID] = endZPathList[i];
+  }
+
+  int startPathPointNum = startPathStart[groupNum];
+  std::vector<int32_t> startPathStartCopy(startPathStart, startPathStart + groupNum + 1);
+  std::vector<float> startPathXCopy(startPathX, startPathX + startPathPointNum);
+  std::vector<float> startPathYCopy(startPathY, startPathY + startPathPointNum);
+  std::vector<float> startPathZCopy(startPathZ, startPathZ + startPathPointNum);
+
+  if (pathPointsLoaded) {
+    int pathPointNum = pathPointStart[pathNum];
+    std::vector<int32_t> pointStart(pathNum + 1, 0);
+    for (int i = 0; i < pathNum; i++) {
+      pointStart[newPathID[i] + 1] = pathPointStart[i + 1] - pathPointStart[i];
+    }
+    for (int i = 0; i < pathNum; i++) {
+      pointStart[i + 1] += pointStart[i];
+    }
+
+    std::vector<float> pointX(pathPointNum), pointY(pathPointNum), pointZ(pathPointNum), pointIntensity(pathPointNum);
+    for (int i = 0; i < pathNum; i++) {
+      int pointInd = pointStart[newPathID[i]];
+      int pathPointEnd = pathPointStart[i + 1];
+      for (int j = pathPointStart[i]; j < pathPointEnd; j++) {
+        pointX[pointInd] = pathPointX[j];
+        pointY[pointInd] = pathPointY[j];
+        pointZ[pointInd] = pathPointZ[j];
+        pointIntensity[pointInd] = pathPointIntensity[j];
+        pointInd++;
+      }
+    }
+
+    pathLibData.pathPointStart.swap(pointStart);
+    pathLibData.pathPointX.swap(pointX);
+    pathLibData.pathPointY.swap(pointY);
+    pathLibData.pathPointZ.swap(pointZ);
+    pathLibData.pathPointIntensity.swap(pointIntensity);
+  }
+
+  int correspondenceNum = correspondenceStart[gridVoxelNum];
+  std::vector<int32_t> correspondenceStartCopy(correspondenceStart, correspondenceStart + gridVoxelNum + 1);
+  std::vector<uint16_t> correspondence(correspondenceNum);
+  for (int i = 0; i < correspondenceNum; i++) {
+    correspondence[i] = newPathID[correspondences[i]];
+  }
+
+  pathLibData.pathGroup.swap(pathGroup);
+  pathLibData.endPitch.swap(endPitch);
+  pathLibData.endYaw.swap(endYaw);
+  pathLibData.endZ.swap(endZ);
+  pathLibData.startPathStart.swap(startPathStartCopy);
+  pathLibData.startPathX.swap(startPathXCopy);
+  pathLibData.startPathY.swap(startPathYCopy);
+  pathLibData.startPathZ.swap(startPathZCopy);
+  pathLibData.correspondenceStart.swap(correspondenceStartCopy);
+  pathLibData.correspondence.swap(correspondence);
+  setPathTables();
+}
+
+void buildCorrespondenceWords()
+{
+  correspondenceWordStart.resize(gridVoxelNum + 1);
+  correspondenceWordID.clear();
+  correspondenceWordMask.clear();
+
+  for (int i = 0; i < gridVoxelNum; i++) {
+    correspondenceWordStart[i] = correspondenceWordID.size();
+
+    int correspondenceEnd = correspondenceStart[i + 1];
+    for (int j = correspondenceStart[i]; j < correspondenceEnd; j++) {
+      int pathID = correspondences[j];
+      int wordID = pathID / 64;
+      uint64_t bit = uint64_t(1) << (pathID % 64);
+
+      int wordStart = correspondenceWordStart[i];
+      int wordEnd = correspondenceWordID.size();
+      int k = wordStart;
+      while (k < wordEnd && correspondenceWordID[k] != wordID) k++;
+      if (k < wordEnd) {
+        correspondenceWordMask[k] |= bit;
+      } else {
+        correspondenceWordID.push_back(wordID);
+        correspondenceWordMask.push_back(bit);
+      }
+    }
+  }
+  correspondenceWordStart[gridVoxelNum] = correspondenceWordID.size();
+
+  countPlaneNum = 0;
+  while (countPlaneNum < maxCountPlaneNum && (pointPerPathThre >> countPlaneNum) > 0) {
+    countPlaneNum++;
+  }
+
+  pathWordNum = (pathNum + 63) / 64;
+}
+
+void resetPathVoteWords(PathSearch& search)
+{
+  search.pathCountPlanes.assign(countPlaneNum * pathWordNum, 0);
+  search.blockedPathWords.assign(pathWordNum, 0);
+}
+
+void addVoxelVoteWords(PathSearch& search, int ind)
+{
+  uint64_t *pathCountPlanes = &search.pathCountPlanes[0];
+  uint64_t *blockedPathWords = &search.blockedPathWords[0];
+
+  int wordEnd = correspondenceWordStart[ind + 1];
+  for (int k = correspondenceWordStart[ind]; k < wordEnd; k++) {
+    int wordID = correspondenceWordID[k];
+    uint64_t mask = correspondenceWordMask[k] & ~blockedPathWords[wordID];
+    if (mask == 0) continue;
+
+    uint64_t carry = mask;
+    uint64_t reached = mask;
+    for (int p = 0; p < countPlaneNum; p++) {
+      uint64_t plane = pathCountPlanes[p * pathWordNum + wordID];
+      uint64_t carryNext = plane & carry;
+      plane ^= carry;
+      pathCountPlanes[p * pathWordNum + wordID] = plane;
+      carry = carryNext;
+
+      if ((pointPerPathThre >> p) & 1) reached &= plane;
+      else reached &= ~plane;
+    }
+
+    blockedPathWords[wordID] |= reached;
+  }
+}
+
+void extractPathVoteWords(PathSearch& search)
+{
+  for (int i = 0; i < pathNum; i++) {
+    search.clearPathList[i] = ((search.blockedPathWords[i / 64] >> (i % 64)) & 1) ? pointPerPathThre : 0;
+  }
+}
+
+// bins the planner cloud into the collision grid and votes for the blocked paths, instantiated
+// with the stock grid dimensions as constants and with the runtime dimensions
+template <bool stockDims>
+void voteCloudPoints(PathSearch& search)
+{
+  const double pathScale = search.pathScale;
+
+  const int voxelNumX = stockDims ? stockGridVoxelNumX : gridVoxelNumX;
+  const int voxelNumY = stockDims ? stockGridVoxelNumY : gridVoxelNumY;
+  const int voxelNumZ = stockDims ? stockGridVoxelNumZ : gridVoxelNumZ;
+
+  int plannerCloudSize = plannerCloud->points.size();
+  for (int i = 0; i < plannerCloudSize; i++) {
+    float x = plannerCloud->points[i].x / pathScale;
+    float y = plannerCloud->points[i].y / pathScale;
+    float z = plannerCloud->points[i].z / pathScale;
+    float dis = sqrt(x * x + y * y);
+
+    if (x > 0 && (dis <= (relativeGoalDis + stopDis) / pathScale || relativeGoalX < 0) && 
+        z > lowerBoundZ / pathScale && z < upperBoundZ / pathScale) {
+      float scaleY = x / gridVoxelOffsetX + searchRadiusHori / gridVoxelOffsetY
+                   * (gridVoxelOffsetX - x) / gridVoxelOffsetX;
+      float scaleZ = x / gridVoxelOffsetX + searchRadiusVert / gridVoxelOffsetZ
+                   * (gridVoxelOffsetX - x) / gridVoxelOffsetX;
+
+      int indX = int((gridVoxelOffsetX + gridVoxelSize / 2 - x) / gridVoxelSize);
+      int indY = int((gridVoxelOffsetY + gridVoxelSize / 2 - y / scaleY) / gridVoxelSize);
+      int indZ = int((gridVoxelOffsetZ + gridVoxelSize / 2 - z / scaleZ) / gridVoxelSize);
+      if (indX >= 0 && indX < voxelNumX && indY >= 0 && indY < voxelNumY && 
+          indZ >= 0 && indZ < voxelNumZ) {
+        int ind = voxelNumY * voxelNumZ * indX + voxelNumZ * indY + indZ;
+        if (bitsetVoting) {
+          addVoxelVoteWords(search, ind);
+        } else {
+          int correspondenceEnd = correspondenceStart[ind + 1];
+          for (int j = correspondenceStart[ind]; j < correspondenceEnd; j++) {
+            search.clearPathList[correspondences[j]]++;
+          }
+        }
+      }
+    }
+  }
+}
+
+// votes and scores the paths at search.pathScale and selects the best group, -1 if none is free
+void searchPathScale(PathSearch& search)
+{
+  std::fill(search.clearPathList.begin(), search.clearPathList.end(), 0);
+  if (bitsetVoting) {
+    resetPathVoteWords(search);
+  }
+
+  ScopedStageTimer votingTimer(stageProfiler, stagePathVoting);
+  if (stockGrid) {
+    voteCloudPoints<true>(search);
+  } else {
+    voteCloudPoints<false>(search);
+  }
+  if (bitsetVoting) {
+    extractPathVoteWords(search);
+  }
+  votingTimer.stop();
+
+  ScopedStageTimer scoringTimer(stageProfiler, stageGroupScoring);
+  accumulateGroupScores(groupNum, &groupPathStart[0], pointPerPathThre, &pathFovPenalty[0], &pathGoalScore[0],
+                        &search.clearPathList[0], &search.clearPathPerGroupScore[0]);
+
+  float maxScore = 0;
+  int selectedGroupID = -1;
+  for (int i = 0; i < groupNum; i++) {
+    if (maxScore < search.clearPathPerGroupScore[i]) {
+      maxScore = search.clearPathPerGroupScore[i];
+      selectedGroupID = i;
+    }
+  }
+
+  search.selectedGroupID = selectedGroupID;
+  scoringTimer.stop();
+}
+
+void initPlannerPipeline()
+{
+  printf ("\nReading path files.\n");
+
+  if (laserCloudStackNum < 1) laserCloudStackNum = 1;
+  laserCloudStack.resize(laserCloudStackNum);
+  for (int i = 0; i < laserCloudStackNum; i++) {
+    laserCloudStack[i].reset(new pcl::PointCloud<pcl::PointXYZ>());
+  }
+  for (int i = 0; i < 3; i++) {
+    plannerFrameSlot.buffer(i).cloud.reset(new pcl::PointCloud<pcl::PointXYZ>());
+    plannerFrameSlot.buffer(i).cloud->points.reserve(65536);
+  }
+  downSizeFilter.setLeafSize(scanVoxelSize, scanVoxelSize, scanVoxelSize);
+  scanHashFilter.setLeafSize(scanVoxelSize);
+  plannerVoxelStack.setLeafSize(scanVoxelSize);
+  plannerVoxelStack.setFrameNum(laserCloudStackNum);
+  scanHashFilter.reserve(65536);
+  plannerVoxelStack.reserve(65536);
+  scanTemporalFilter.init(scanVoxelSize, temporalFilterFrames, temporalFilterMinHits, temporalFilterPassDis, 1 << 17);
+  surrOccupancyMap.init(scanVoxelSize, keepHoriDis, keepVertDis, keepDecayFrames, keepMinHits, 255);
+
+  bool pathLibraryRead = false;
+  if (usePathLibrary) {
+    pathLibraryRead = readPathLibrary();
+    pathPointsLoaded = pathLibraryRead;
+    if (!pathLibraryRead) {
+      printf ("\nCannot use path library, reading PLY files.\n");
+    }
+  }
+
+  if (!pathLibraryRead) {
+    readPathList();
+    readStartPaths();
+    gridVoxelNum = gridVoxelNumX * gridVoxelNumY * gridVoxelNumZ;
+    readCorrespondences();
+    setPathTables();
+  }
+
+  sortPathsByGroup();
+
+  stockGrid = gridVoxelNumX == stockGridVoxelNumX && gridVoxelNumY == stockGridVoxelNumY &&
+              gridVoxelNumZ == stockGridVoxelNumZ;
+  if (bitsetVoting) {
+    buildCorrespondenceWords();
+  }
+
+  pathFovPenalty.assign(pathNum, 0);
+  pathGoalScore.assign(pathNum, 0);
+
+  int maxScaleNum = 1;
+  if (pathScaleStep > 0 && pathScale > minPathScale) {
+    maxScaleNum = int((pathScale - minPathScale) / pathScaleStep) + 2;
+  }
+  pathSearches.resize(maxScaleNum);
+  for (int i = 0; i < maxScaleNum; i++) {
+    pathSearches[i].clearPathList.assign(pathNum, 0);
+    pathSearches[i].clearPathPerGroupScore.assign(groupNum, 0);
+    if (bitsetVoting) {
+      resetPathVoteWords(pathSearches[i]);
+    }
+  }
+
+  if (parallelScaleSearch) {
+    int workerNum = int(std::thread::hardware_concurrency()) - 1;
+    if (workerNum > maxScaleNum - 1) workerNum = maxScaleNum - 1;
+    if (workerNum > 0) scaleWorkerPool.start(workerNum);
+  }
+}
+
+bool takePlannerFrame()
+{
+  if (!plannerFrameSlot.update()) {
+    return false;
+  }
+
+  PlannerFrame& frame = plannerFrameSlot.readBuffer();
+  plannerCloud = frame.cloud;
+  plannerCloudTime = frame.time;
+  plannerCloudStamp = frame.stamp;
+  plannerVehiclePitch = frame.vehiclePitch;
+  plannerVehicleYaw = frame.vehicleYaw;
+  plannerCloudCameraFrame = frame.cameraFrame;
+  memcpy(plannerCameraToWorld, frame.cameraToWorld, sizeof(plannerCameraToWorld));
+
+  return true;
+}
+
+void getPlannerCloudWorld(pcl::PointCloud<pcl::PointXYZ>& cloud)
+{
+  cloud = *plannerCloud;
+  if (plannerCloudCameraFrame) {
+    transformCloud(cloud, plannerCameraToWorld);
+  }
+}
+
+int planPaths()
+{
+  ScopedStageTimer toTrackTimer(stageProfiler, stageCloudToTrack);
+  float sinTrackPitch = sin(trackPitch);
+  float cosTrackPitch = cos(trackPitch);
+  float sinTrackYaw = sin(trackYaw);
+  float cosTrackYaw = cos(trackYaw);
+
+  // world to track point frame, composed with the camera to world transform of a frame kept in
+  // the camera frame
+  double worldToTrack[12] = {cosTrackPitch * cosTrackYaw, cosTrackPitch * sinTrackYaw, -sinTrackPitch, 0,
+                             -sinTrackYaw, cosTrackYaw, 0, 0,
+                             sinTrackPitch * cosTrackYaw, sinTrackPitch * sinTrackYaw, cosTrackPitch, 0};
+  for (int i = 0; i < 3; i++) {
+    worldToTrack[4 * i + 3] = -(worldToTrack[4 * i] * trackX + worldToTrack[4 * i + 1] * trackY +
+                                worldToTrack[4 * i + 2] * trackZ);
+  }
+
+  float toTrack[12];
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 4; j++) {
+      if (plannerCloudCameraFrame) {
+        double value = j == 3 ? worldToTrack[4 * i + 3] : 0;
+        for (int k = 0; k < 3; k++) {
+          value += worldToTrack[4 * i + k] * plannerCameraToWorld[4 * k + j];
+        }
+        toTrack[4 * i + j] = value;
+      } else {
+        toTrack[4 * i + j] = worldToTrack[4 * i + j];
+      }
+    }
+  }
+  transformCloud(*plannerCloud, toTrack);
+
+  toTrackTimer.stop();
+
+  float goalX1 = (goalX - trackX) * cosTrackYaw + (goalY - trackY) * sinTrackYaw;
+  float goalY1 = -(goalX - trackX) * sinTrackYaw + (goalY - trackY) * cosTrackYaw;
+  float goalZ1 = goalZ - trackZ;
+
+  relativeGoalX = (goalX1 * cosTrackPitch - goalZ1 * sinTrackPitch);
+  float relativeGoalY = goalY1;
+  float relativeGoalZ = (goalX1 * sinTrackPitch + goalZ1 * cosTrackPitch);
+
+  relativeGoalDis = sqrt(relativeGoalX * relativeGoalX + relativeGoalY * relativeGoalY);
+  relativeGoalPitch = -atan2(relativeGoalZ, sqrt(relativeGoalX * relativeGoalX 
+                        + relativeGoalY * relativeGoalY)) * 180.0 / PI;
+  relativeGoalYaw = atan2(relativeGoalY, relativeGoalX) * 180.0 / PI;
+
+  if (relativeGoalPitch < -pitchDiffLimit) relativeGoalPitch = -pitchDiffLimit;
+  else if (relativeGoalPitch > pitchDiffLimit) relativeGoalPitch = pitchDiffLimit;
+  if (relativeGoalYaw < -yawDiffLimit) relativeGoalYaw = -yawDiffLimit;
+  else if (relativeGoalYaw > yawDiffLimit) relativeGoalYaw = yawDiffLimit;
+
+  if (manualMode || (autonomyMode && autoAdjustMode)) {
+    relativeGoalDis = 1000.0;
+    relativeGoalPitch = 0;
+    relativeGoalYaw = 0;
+  } else if (!autonomyMode) {
+    relativeGoalDis = 1000.0;
+    relativeGoalPitch = -joyUp;
+    relativeGoalYaw = joyLeft;
+  }
+
+  ScopedStageTimer frameScoringTimer(stageProfiler, stageFrameScoring);
+  PathScoringFrame scoringFrame;
+  scoringFrame.trackPitch = trackPitch;
+  scoringFrame.trackYaw = trackYaw;
+  scoringFrame.trackZ = trackZ;
+  scoringFrame.vehiclePitch = plannerVehiclePitch;
+  scoringFrame.vehicleYaw = plannerVehicleYaw;
+  scoringFrame.depthCamPitchOffset = depthCamPitchOffset;
+  scoringFrame.sensorMaxPitch = sensorMaxPitch;
+  scoringFrame.sensorMaxYaw = sensorMaxYaw;
+  scoringFrame.maxElev = maxElev;
+  scoringFrame.relativeGoalPitch = relativeGoalPitch;
+  scoringFrame.relativeGoalYaw = relativeGoalYaw;
+  scoringFrame.pitchDiffLimit = pitchDiffLimit;
+  scoringFrame.pitchWeight = pitchWeight;
+  scoringFrame.yawWeight = yawWeight;
+  scoringFrame.pointPerPathThre = pointPerPathThre;
+  scorePathsForFrame(scoringFrame, pathNum, endPitchPathList, endYawPathList, endZPathList,
+                     &pathFovPenalty[0], &pathGoalScore[0]);
+  frameScoringTimer.stop();
+
+  int scaleNum = 0;
+  double searchScale = pathScale;
+  if (manualMode || (autonomyMode && autoAdjustMode)) searchScale = minPathScale;
+  else if (pathScaleBySpeed) searchScale *= joyFwd;
+  if (searchScale < minPathScale) searchScale = minPathScale;
+
+  while (searchScale >= minPathScale && scaleNum < int(pathSearches.size())) {
+    pathSearches[scaleNum].pathScale = searchScale;
+    scaleNum++;
+
+    if (pathScaleStep <= 0) break;
+    searchScale -= pathScaleStep;
+  }
+
+  // the largest scale with a free group is used, as when the scales are searched one by one
+  ScopedStageTimer scaleSearchTimer(stageProfiler, stageScaleSearch);
+  int selectedScaleID = -1;
+  if (parallelScaleSearch && scaleNum > 1) {
+    scaleWorkerPool.run(scaleNum, [](int i) { searchPathScale(pathSearches[i]); });
+    for (int i = 0; i < scaleNum; i++) {
+      if (pathSearches[i].selectedGroupID >= 0) {
+        selectedScaleID = i;
+        break;
+      }
+    }
+  } else {
+    for (int i = 0; i < scaleNum; i++) {
+      searchPathScale(pathSearches[i]);
+      if (pathSearches[i].selectedGroupID >= 0) {
+        selectedScaleID = i;
+        break;
+      }
+    }
+  }
+
+  scaleSearchTimer.stop();
+
+  return selectedScaleID;
+}
@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "plannerPipeline.h"
+#include "plannerRecording.h"
+
+using namespace std;
+
+// Replays a recording written by localPlanner with recordFile set through the same pipeline
+// code, without ROS. Parameters are taken from the recording and can be overridden on the
+// command line, e.g. plannerReplay run.plrc bitsetVoting=true parallelScaleSearch=true. Reports
+// the planning rate and the per-stage latency distributions, and a digest of the selected paths
+// for comparing runs with different parameters. Scans are transformed with the pose recorded
+// with them, so useCloudStamp and depthCloudDelay have no effect on a replay.
+
+void applyParams(const char *text, int size)
+{
+  string params(text, size);
+  size_t lineStart = 0;
+  while (lineStart < params.size()) {
+    size_t lineEnd = params.find('\n', lineStart);
+    if (lineEnd == string::npos) lineEnd = params.size();
+
+    string line = params.substr(lineStart, lineEnd - lineStart);
+    size_t split = line.find('=');
+    if (split != string::npos && !setPlannerParam(line.substr(0, split), line.substr(split + 1))) {
+      printf ("Unknown parameter %s in recording.\n", line.substr(0, split).c_str());
+    }
+
+    lineStart = lineEnd + 1;
+  }
+}
+
+uint64_t hashValue(uint64_t hash, int value)
+{
+  for (int i = 0; i < 4; i++) {
+    hash = (hash ^ ((uint32_t(value) >> (8 * i)) & 0xff)) * 1099511628211ull;
+  }
+  return hash;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2) {
+    printf ("\nUsage: plannerReplay <recording> [name=value ...]\n\n");
+    return 1;
+  }
+
+  PlannerRecordReader reader;
+  if (!reader.open(argv[1])) {
+    printf ("\nCannot read recording %s, exit.\n\n", argv[1]);
+    exit(1);
+  }
+
+  uint32_t type;
+  vector<char> payload;
+  if (!reader.next(type, payload) || type != recordParams) {
+    printf ("\nRecording %s has no parameters, exit.\n\n", argv[1]);
+    exit(1);
+  }
+  applyParams(payload.data(), payload.size());
+
+  for (int i = 2; i < argc; i++) {
+    string arg = argv[i];
+    size_t split = arg.find('=');
+    if (split == string::npos || !setPlannerParam(arg.substr(0, split), arg.substr(split + 1))) {
+      printf ("\nUnknown parameter %s, exit.\n\n", argv[i]);
+      exit(1);
+    }
+  }
+
+  stageProfiler.init(plannerStageNames, plannerStageNum);
+  initPlannerPipeline();
+
+  int scanNum = 0, frameNum = 0, freeFrameNum = 0, unmatchedFrameNum = 0;
+  uint64_t pathDigest = 14695981039346656037ull;
+  int64_t planningNs = 0;
+  int64_t replayStartNs = StageProfiler::nowNs();
+  while (reader.next(type, payload)) {
+    if (type == recordScan && payload.size() >= sizeof(ScanRecord)) {
+      const ScanRecord *scan = (const ScanRecord *)payload.data();
+      if (payload.size() != sizeof(ScanRecord) + 3 * sizeof(float) * uint64_t(scan->pointNum)) {
+        printf ("\nMalformed scan record, stopping.\n");
+        break;
+      }
+
+      startRecordedLaserFrame(*scan);
+      ScopedStageTimer totalTimer(stageProfiler, stageScanTotal);
+
+      ScopedStageTimer inputTimer(stageProfiler, stageScanInput);
+      const float *points = (const float *)(payload.data() + sizeof(ScanRecord));
+      for (uint32_t i = 0; i < scan->pointNum; i++) {
+        addCropPoint(points[3 * i], points[3 * i + 1], points[3 * i + 2]);
+      }
+      inputTimer.stop();
+
+      finishLaserFrame(scan->stamp);
+      scanNum++;
+    } else if (type == recordPlan && payload.size() == sizeof(PlanRecord)) {
+      const PlanRecord *plan = (const PlanRecord *)payload.data();
+      goalX = plan->goalX;
+      goalY = plan->goalY;
+      goalZ = plan->goalZ;
+      trackX = plan->trackX;
+      trackY = plan->trackY;
+      trackZ = plan->trackZ;
+      trackRoll = plan->trackRoll;
+      trackPitch = plan->trackPitch;
+      trackYaw = plan->trackYaw;
+      joyFwd = plan->joyFwd;
+      joyLeft = plan->joyLeft;
+      joyUp = plan->joyUp;
+      manualMode = plan->manualMode;
+      autonomyMode = plan->autonomyMode;
+      autoAdjustMode = plan->autoAdjustMode;
+
+      if (!takePlannerFrame()) {
+        continue;
+      }
+      if (plannerCloudStamp != plan->scanStamp) {
+        unmatchedFrameNum++;
+      }
+
+      int64_t planStartNs = StageProfiler::nowNs();
+      ScopedStageTimer planningTimer(stageProfiler, stagePlanningTotal);
+      int selectedScaleID = planPaths();
+      planningTimer.stop();
+      planningNs += StageProfiler::nowNs() - planStartNs;
+
+      pathDigest = hashValue(pathDigest, selectedScaleID);
+      if (selectedScaleID >= 0) {
+        pathDigest = hashValue(pathDigest, pathSearches[selectedScaleID].selectedGroupID);
+        freeFrameNum++;
+      }
+      frameNum++;
+    } else if (type == recordClearSurrCloud) {
+      clearSurrCloudRequest = true;
+    }
+  }
+  double replaySec = 1.0e-9 * (StageProfiler::nowNs() - replayStartNs);
+
+  printf ("\n%d scans, %d planned frames, %d with a free path, digest %016llx\n", scanNum, frameNum,
+          freeFrameNum, (unsigned long long)pathDigest);
+  if (unmatchedFrameNum > 0) {
+    printf ("%d planned frames are not on the scan planned in the recording\n", unmatchedFrameNum);
+  }
+  printf ("replay %.3f s, %.1f frames/s, %.1f frames/s planning only\n\n", replaySec,
+          replaySec > 0 ? frameNum / replaySec : 0, planningNs > 0 ? 1.0e9 * frameNum / planningNs : 0);
+
+  printf ("%-16s %8s %10s %10s %10s %10s\n", "stage", "count", "mean ms", "p50 ms", "p99 ms", "max ms");
+  for (int i = 0; i < plannerStageNum; i++) {
+    StageStats stats;
+    stageProfiler.snapshot(i, stats);
+    if (stats.count == 0) continue;
+
+    printf ("%-16s %8llu %10.3f %10.3f %10.3f %10.3f\n", plannerStageNames[i], (unsigned long long)stats.count,
+            stats.meanMs, stats.p50Ms, stats.p99Ms, stats.maxMs);
+  }
+
+  return 0;
+}
@@ -0,0 +1,163 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+
+#include "pathScoring.h"
+
+using namespace std;
+
+// compares the original per-scale path scoring loop of localPlanner against the per-frame
+// scorePathsForFrame() pass plus one accumulateGroupScores() pass per scale on a synthetic path
+// set ordered by group, and checks that the group scores and collision counts are bit-identical
+
+const double PI = 3.1415926;
+
+int pathNum = 4375;
+int groupNum = 25;
+int scaleNum = 4;
+int frameNum = 2000;
+int pointPerPathThre = 2;
+
+double depthCamPitchOffset = 0;
+double sensorMaxPitch = 25.0;
+double sensorMaxYaw = 40.0;
+double maxElev = 1.0;
+double pitchDiffLimit = 35.0;
+double pitchWeight = 0.02;
+double yawWeight = 0.02;
+
+vector<int> pathGroup, groupPathStart;
+vector<float> endPitch, endYaw, endZ;
+
+float randomFloat(unsigned int& seed, float minVal, float maxVal)
+{
+  seed = seed * 1103515245 + 12345;
+  return minVal + (maxVal - minVal) * ((seed >> 8) & 0xFFFF) / 65535.0;
+}
+
+void referenceScoring(const PathScoringFrame& frame, int *clearPathList, float *groupScore)
+{
+  for (int i = 0; i < pathNum; i++) {
+    float vehiclePitch = frame.vehiclePitch;
+    float vehicleYaw = frame.vehicleYaw;
+    float pitch = endPitch[i];
+    float yaw = frame.trackYaw * 180.0 / PI + endYaw[i];
+    float pitchDiff = fabs(pitch + frame.trackPitch * 180.0 / PI - vehiclePitch * 180.0 / PI - depthCamPitchOffset * 180.0 / PI);
+    float yawDiff = fabs(yaw - vehicleYaw * 180.0 / PI);
+    if (yawDiff > 180.0) yawDiff = 360.0 - yawDiff;
+    float elev = frame.trackZ + endZ[i];
+    if (yawDiff > sensorMaxYaw || pitchDiff > sensorMaxPitch || elev > maxElev) {
+      clearPathList[i] += pointPerPathThre;
+      continue;
+    }
+    if (clearPathList[i] < pointPerPathThre) {
+      float pitchDiff = fabs(frame.relativeGoalPitch - endPitch[i]);
+      if (pitchDiff > pitchDiffLimit) {
+        pitchDiff = pitchDiffLimit;
+      }
+      float yawDiff = fabs(frame.relativeGoalYaw - endYaw[i]);
+      if (yawDiff > 180.0) {
+        yawDiff = 360.0 - yawDiff;
+      }
+
+      float score = (1 - pitchWeight * pitchDiff) * (1 - yawWeight * yawDiff);
+      if (score < 0) score = 0;
+      groupScore[pathGroup[i]] += score + 0.000001;
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  if (argc > 1) pathNum = atoi(argv[1]);
+  if (argc > 2) scaleNum = atoi(argv[2]);
+  if (argc > 3) frameNum = atoi(argv[3]);
+
+  unsigned int seed = 1;
+  pathGroup.resize(pathNum);
+  endPitch.resize(pathNum);
+  endYaw.resize(pathNum);
+  endZ.resize(pathNum);
+  for (int i = 0; i < pathNum; i++) {
+    pathGroup[i] = i * groupNum / pathNum;
+    endPitch[i] = randomFloat(seed, -30.0, 30.0);
+    endYaw[i] = randomFloat(seed, -180.0, 180.0);
+    endZ[i] = randomFloat(seed, -1.0, 1.0);
+  }
+
+  // paths are in group order as after loading in localPlanner
+  groupPathStart.assign(groupNum + 1, 0);
+  for (int i = 0; i < pathNum; i++) {
+    groupPathStart[pathGroup[i] + 1]++;
+  }
+  for (int i = 0; i < groupNum; i++) {
+    groupPathStart[i + 1] += groupPathStart[i];
+  }
+
+  vector<int> clearPathInput(scaleNum * pathNum);
+  vector<int> referenceClear(pathNum), kernelClear(pathNum);
+  vector<float> referenceScore(groupNum), kernelScore(groupNum);
+  vector<int> fovPenalty(pathNum);
+  vector<double> pathScore(pathNum);
+
+  double referenceTime = 0, kernelTime = 0;
+  int mismatchNum = 0;
+  for (int frameID = 0; frameID < frameNum; frameID++) {
+    PathScoringFrame frame;
+    frame.trackPitch = randomFloat(seed, -0.3, 0.3);
+    frame.trackYaw = randomFloat(seed, -PI, PI);
+    frame.trackZ = randomFloat(seed, -0.5, 0.5);
+    frame.vehiclePitch = randomFloat(seed, -0.3, 0.3);
+    frame.vehicleYaw = randomFloat(seed, -PI, PI);
+    frame.depthCamPitchOffset = depthCamPitchOffset;
+    frame.sensorMaxPitch = sensorMaxPitch;
+    frame.sensorMaxYaw = sensorMaxYaw;
+    frame.maxElev = maxElev;
+    frame.relativeGoalPitch = randomFloat(seed, -30.0, 30.0);
+    frame.relativeGoalYaw = randomFloat(seed, -180.0, 180.0);
+    frame.pitchDiffLimit = pitchDiffLimit;
+    frame.pitchWeight = pitchWeight;
+    frame.yawWeight = yawWeight;
+    frame.pointPerPathThre = pointPerPathThre;
+
+    for (int i = 0; i < scaleNum * pathNum; i++) {
+      clearPathInput[i] = randomFloat(seed, 0, 1.0) < 0.7 ? 0 : 1 + int(randomFloat(seed, 0, 3.0));
+    }
+
+    chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+    for (int s = 0; s < scaleNum; s++) {
+      referenceClear.assign(clearPathInput.begin() + s * pathNum, clearPathInput.begin() + (s + 1) * pathNum);
+      referenceScore.assign(groupNum, 0);
+      referenceScoring(frame, &referenceClear[0], &referenceScore[0]);
+    }
+    chrono::steady_clock::time_point midTime = chrono::steady_clock::now();
+    scorePathsForFrame(frame, pathNum, &endPitch[0], &endYaw[0], &endZ[0], &fovPenalty[0], &pathScore[0]);
+    for (int s = 0; s < scaleNum; s++) {
+      kernelClear.assign(clearPathInput.begin() + s * pathNum, clearPathInput.begin() + (s + 1) * pathNum);
+      accumulateGroupScores(groupNum, &groupPathStart[0], pointPerPathThre, &fovPenalty[0], &pathScore[0],
+                            &kernelClear[0], &kernelScore[0]);
+    }
+    chrono::steady_clock::time_point endTime = chrono::steady_clock::now();
+
+    referenceTime += chrono::duration<double, micro>(midTime - startTime).count();
+    kernelTime += chrono::duration<double, micro>(endTime - midTime).count();
+
+    // only the last scale is compared after timing, all scales share the same code path
+    for (int i = 0; i < groupNum; i++) {
+      if (referenceScore[i] != kernelScore[i]) mismatchNum++;
+    }
+    for (int i = 0; i < pathNum; i++) {
+      if (referenceClear[i] != kernelClear[i]) mismatchNum++;
+    }
+  }
+
+  printf ("\n%d frames, %d paths, %d groups, %d scales/frame\n", frameNum, pathNum, groupNum, scaleNum);
+  printf ("Per-scale loop:        %8.2f us/frame\n", referenceTime / frameNum);
+  printf ("Precomputed scoring:   %8.2f us/frame\n", kernelTime / frameNum);
+  printf ("Speedup:               %8.2fx\n", referenceTime / kernelTime);
+  printf ("Mismatches:            %8d\n\n", mismatchNum);
+
+  return mismatchNum > 0 ? 1 : 0;
+}
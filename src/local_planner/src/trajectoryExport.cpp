@@ -0,0 +1,54 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "trajectoryLogger.h"
+
+// Converts a pathFollower trajectory log to the desired trajectory (track point x y z yaw time)
+// and executed trajectory (vehicle x y z roll pitch yaw time) text files.
+
+int main(int argc, char** argv)
+{
+  if (argc != 4) {
+    printf ("\nUsage: trajectoryExport <trajectory log> <desired trajectory file> <executed trajectory file>\n\n");
+    return 1;
+  }
+
+  FILE *logFilePtr = fopen(argv[1], "rb");
+  if (logFilePtr == NULL) {
+    printf ("\nCannot read input file %s, exit.\n\n", argv[1]);
+    exit(1);
+  }
+
+  uint32_t fileHeader[2];
+  if (fread(fileHeader, sizeof(fileHeader), 1, logFilePtr) != 1 || fileHeader[0] != trajectoryLogMagic ||
+      fileHeader[1] != trajectoryLogVersion) {
+    printf ("\n%s is not a trajectory log, exit.\n\n", argv[1]);
+    exit(1);
+  }
+
+  FILE *desiredTrajFilePtr = fopen(argv[2], "w");
+  FILE *executedTrajFilePtr = fopen(argv[3], "w");
+  if (desiredTrajFilePtr == NULL || executedTrajFilePtr == NULL) {
+    printf ("\nCannot write output files, exit.\n\n");
+    exit(1);
+  }
+
+  int recordNum = 0;
+  TrajectoryRecord record;
+  while (fread(&record, sizeof(record), 1, logFilePtr) == 1) {
+    fprintf(desiredTrajFilePtr, "%f %f %f %f %lf\n", record.trackX, record.trackY, record.trackZ, record.trackYaw,
+            record.time);
+    fprintf(executedTrajFilePtr, "%f %f %f %f %f %f %lf\n", record.vehicleX, record.vehicleY, record.vehicleZ,
+            record.roll, record.pitch, record.yaw, record.time);
+    recordNum++;
+  }
+
+  fclose(logFilePtr);
+  fclose(desiredTrajFilePtr);
+  fclose(executedTrajFilePtr);
+
+  printf ("\nExported %d trajectory points.\n\n", recordNum);
+
+  return 0;
+}
@@ -0,0 +1,146 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+#include <pcl/filters/voxel_grid.h>
+
+#include "voxelHashFilter.h"
+
+using namespace std;
+
+// compares the pcl::VoxelGrid chain used by localPlanner (crop, downsize, transform, downsize
+// again in the world frame) against the fused VoxelHashFilter pass on synthetic depth frames
+
+int imageWidth = 640;
+int imageHeight = 480;
+int frameNum = 50;
+float scanVoxelSize = 0.1;
+float maxRange = 4.0;
+
+float sinYaw = sin(0.3);
+float cosYaw = cos(0.3);
+
+void generateFrame(pcl::PointCloud<pcl::PointXYZ>& cloud, int frameID)
+{
+  float fx = 0.5 * imageWidth, fy = 0.5 * imageWidth;
+  float cx = 0.5 * imageWidth, cy = 0.5 * imageHeight;
+
+  cloud.points.resize(imageWidth * imageHeight);
+  cloud.width = imageWidth;
+  cloud.height = imageHeight;
+  cloud.is_dense = false;
+
+  unsigned int seed = frameID * 7919 + 1;
+  for (int v = 0; v < imageHeight; v++) {
+    for (int u = 0; u < imageWidth; u++) {
+      pcl::PointXYZ& point = cloud.points[v * imageWidth + u];
+
+      float depth = 6.0 - 3.0 * float(v) / imageHeight;
+      if (u > imageWidth / 3 && u < imageWidth / 2 && v > imageHeight / 4) depth = 1.5;
+      depth += 0.01 * float(rand_r(&seed) % 100) / 100.0;
+
+      if (rand_r(&seed) % 20 == 0) {
+        point.x = point.y = point.z = NAN;
+      } else {
+        point.x = (u - cx) * depth / fx;
+        point.y = (v - cy) * depth / fy;
+        point.z = depth;
+      }
+    }
+  }
+}
+
+void transformPoint(float x0, float y0, float z0, pcl::PointXYZ& point)
+{
+  float x1 = z0, y1 = -x0, z1 = -y0;
+  point.x = x1 * cosYaw - y1 * sinYaw + 1.0;
+  point.y = x1 * sinYaw + y1 * cosYaw + 2.0;
+  point.z = z1 + 1.0;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc > 1) frameNum = atoi(argv[1]);
+  if (argc > 2) scanVoxelSize = atof(argv[2]);
+
+  vector<pcl::PointCloud<pcl::PointXYZ>::Ptr> frames(4);
+  for (int i = 0; i < 4; i++) {
+    frames[i].reset(new pcl::PointCloud<pcl::PointXYZ>());
+    generateFrame(*frames[i], i);
+  }
+
+  pcl::PointCloud<pcl::PointXYZ>::Ptr cloudCrop(new pcl::PointCloud<pcl::PointXYZ>());
+  pcl::PointCloud<pcl::PointXYZ>::Ptr cloudDwz(new pcl::PointCloud<pcl::PointXYZ>());
+  pcl::PointCloud<pcl::PointXYZ>::Ptr plannerCloud(new pcl::PointCloud<pcl::PointXYZ>());
+  pcl::VoxelGrid<pcl::PointXYZ> downSizeFilter;
+  downSizeFilter.setLeafSize(scanVoxelSize, scanVoxelSize, scanVoxelSize);
+
+  VoxelHashFilter scanHashFilter, plannerHashFilter;
+  scanHashFilter.setLeafSize(scanVoxelSize);
+  plannerHashFilter.setLeafSize(scanVoxelSize);
+  scanHashFilter.reserve(65536);
+  plannerHashFilter.reserve(65536);
+
+  double voxelGridTime = 0, hashTime = 0;
+  int voxelGridPointNum = 0, hashPointNum = 0;
+  for (int frame = 0; frame < frameNum; frame++) {
+    const pcl::PointCloud<pcl::PointXYZ>& laserCloud = *frames[frame % 4];
+    int laserCloudSize = laserCloud.points.size();
+
+    chrono::steady_clock::time_point startTime = chrono::steady_clock::now();
+
+    cloudCrop->clear();
+    for (int i = 0; i < laserCloudSize; i++) {
+      if (laserCloud.points[i].z < maxRange) {
+        cloudCrop->push_back(laserCloud.points[i]);
+      }
+    }
+    cloudDwz->clear();
+    downSizeFilter.setInputCloud(cloudCrop);
+    downSizeFilter.filter(*cloudDwz);
+    int cloudDwzSize = cloudDwz->points.size();
+    for (int i = 0; i < cloudDwzSize; i++) {
+      pcl::PointXYZ point = cloudDwz->points[i];
+      transformPoint(point.x, point.y, point.z, cloudDwz->points[i]);
+    }
+    plannerCloud->clear();
+    downSizeFilter.setInputCloud(cloudDwz);
+    downSizeFilter.filter(*plannerCloud);
+
+    chrono::steady_clock::time_point midTime = chrono::steady_clock::now();
+
+    scanHashFilter.clear();
+    for (int i = 0; i < laserCloudSize; i++) {
+      if (laserCloud.points[i].z < maxRange) {
+        scanHashFilter.addPoint(laserCloud.points[i].x, laserCloud.points[i].y, laserCloud.points[i].z);
+      }
+    }
+    plannerHashFilter.clear();
+    int scanVoxelNum = scanHashFilter.size();
+    for (int i = 0; i < scanVoxelNum; i++) {
+      float x, y, z;
+      pcl::PointXYZ point;
+      scanHashFilter.getCentroid(i, x, y, z);
+      transformPoint(x, y, z, point);
+      plannerHashFilter.addPoint(point.x, point.y, point.z);
+    }
+    plannerHashFilter.getCloud(*plannerCloud);
+
+    chrono::steady_clock::time_point endTime = chrono::steady_clock::now();
+
+    voxelGridTime += chrono::duration<double, milli>(midTime - startTime).count();
+    hashTime += chrono::duration<double, milli>(endTime - midTime).count();
+    voxelGridPointNum += cloudDwzSize;
+    hashPointNum += scanVoxelNum;
+  }
+
+  printf ("\n%d frames of %dx%d points, voxel size %.3f m\n", frameNum, imageWidth, imageHeight, scanVoxelSize);
+  printf ("VoxelGrid chain:       %8.3f ms/frame, %d voxels/frame\n", voxelGridTime / frameNum, voxelGridPointNum / frameNum);
+  printf ("VoxelHashFilter chain: %8.3f ms/frame, %d voxels/frame\n", hashTime / frameNum, hashPointNum / frameNum);
+  printf ("Speedup:               %8.2fx\n\n", voxelGridTime / hashTime);
+
+  return 0;
+}